@@ -0,0 +1,284 @@
+// Microbenchmarks for the crypto and storage hot paths.
+//
+//   ./cryptify_bench --benchmark_out=bench.json --benchmark_out_format=json
+//
+// Compare two runs with Google Benchmark's tools/compare.py.
+#include "BreachCorpus.hpp"
+#include "Compression.hpp"
+#include "CryptoManager.hpp"
+#include "MultiPbkdf2.hpp"
+#include "PasswordGenerator.hpp"
+#include "VaultSnapshot.hpp"
+#include "dBase.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+
+namespace {
+
+// unique per call, so concurrent or crashed runs never share a file
+std::filesystem::path tempPath(const std::string &name)
+{
+    std::string suffix;
+    for (uint8_t byte : CryptoManager::generateRandomBytes(8)) {
+        suffix += "0123456789abcdef"[byte >> 4];
+        suffix += "0123456789abcdef"[byte & 15];
+    }
+    return std::filesystem::temp_directory_path() / ("cryptify_bench_" + suffix + "_" + name);
+}
+
+// every benchmark database lives in its own temp file, removed on scope exit
+struct TempVault
+{
+    // declared first so the file outlives the connection and is removed
+    // even when the constructor throws after creating it
+    struct File
+    {
+        std::filesystem::path path;
+        ~File()
+        {
+            std::error_code ignored;
+            std::filesystem::remove(path, ignored);
+        }
+    } file;
+    std::unique_ptr<dataBase> db;
+    int userId;
+
+    explicit TempVault(int secrets) : file{tempPath("vault.db")}, db(std::make_unique<dataBase>(file.path.string()))
+    {
+        auto salt = CryptoManager::generateRandomBytes(16);
+        db->addUser("bench", CryptoManager::hashPassword("bench", salt), salt);
+        dataBase::UserQuerey user;
+        db->getUser("bench", user);
+        userId = user.id;
+        fill(secrets);
+    }
+
+    void fill(int secrets)
+    {
+        auto key = CryptoManager::generateRandomBytes(32);
+        auto iv = CryptoManager::generateRandomBytes(12);
+        auto blob = CryptoManager::encrypt(std::string(32, 'x'), key, iv);
+        sqlite3 *raw = nullptr;
+        // one transaction for the prefill, the timed part uses the real API
+        sqlite3_open(file.path.string().c_str(), &raw);
+        sqlite3_exec(raw, "BEGIN;", nullptr, nullptr, nullptr);
+        sqlite3_stmt *stmt;
+        sqlite3_prepare_v2(raw, "INSERT INTO secrets (user_id, title, encrypted_data, iv) VALUES (?, ?, ?, ?);", -1, &stmt, nullptr);
+        for (int i = 0; i < secrets; ++i) {
+            std::string title = "site-" + std::to_string(i);
+            sqlite3_bind_int(stmt, 1, userId);
+            sqlite3_bind_text(stmt, 2, title.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_blob(stmt, 3, blob.data(), blob.size(), SQLITE_STATIC);
+            sqlite3_bind_blob(stmt, 4, iv.data(), iv.size(), SQLITE_STATIC);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_exec(raw, "COMMIT;", nullptr, nullptr, nullptr);
+        sqlite3_close(raw);
+    }
+};
+
+void BM_GenerateRandomBytes(benchmark::State &state)
+{
+    int size = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CryptoManager::generateRandomBytes(size));
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_GenerateRandomBytes)->RangeMultiplier(4)->Range(16, 4096);
+
+// batches of 20-character passwords from one buffered stream
+void BM_GeneratePasswords(benchmark::State &state)
+{
+    PasswordGenerator generator;
+    size_t count = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(generator.generate(count));
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_GeneratePasswords)->RangeMultiplier(10)->Range(1, 10000);
+
+void BM_HashPassword(benchmark::State &state)
+{
+    auto salt = CryptoManager::generateRandomBytes(16);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CryptoManager::hashPassword("correct horse battery staple", salt));
+    }
+}
+BENCHMARK(BM_HashPassword);
+
+void BM_DeriveKey(benchmark::State &state)
+{
+    auto salt = CryptoManager::generateRandomBytes(16);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CryptoManager::deriveKey("correct horse battery staple", salt));
+    }
+}
+BENCHMARK(BM_DeriveKey)->Unit(benchmark::kMillisecond);
+
+template <typename Suite>
+void BM_Encrypt(benchmark::State &state)
+{
+    std::string plaintext(state.range(0), 'p');
+    auto key = CryptoManager::generateRandomBytes(32);
+    auto iv = CryptoManager::generateRandomBytes(12);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CryptoManager::encrypt<Suite>(plaintext, key, iv));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Encrypt, Aes256GcmSuite)->RangeMultiplier(16)->Range(16, 16 << 20);
+BENCHMARK_TEMPLATE(BM_Encrypt, ChaCha20Poly1305Suite)->RangeMultiplier(16)->Range(16, 16 << 20);
+
+template <typename Suite>
+void BM_Decrypt(benchmark::State &state)
+{
+    std::string plaintext(state.range(0), 'p');
+    auto key = CryptoManager::generateRandomBytes(32);
+    auto iv = CryptoManager::generateRandomBytes(12);
+    auto ciphertext = CryptoManager::encrypt<Suite>(plaintext, key, iv);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CryptoManager::decrypt<Suite>(ciphertext, key, iv));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Decrypt, Aes256GcmSuite)->RangeMultiplier(16)->Range(16, 16 << 20);
+BENCHMARK_TEMPLATE(BM_Decrypt, ChaCha20Poly1305Suite)->RangeMultiplier(16)->Range(16, 16 << 20);
+
+// text-like plaintext, the case compression is meant for
+void BM_PackText(benchmark::State &state)
+{
+    if (!Compression::available()) {
+        state.SkipWithError("built without zstd");
+        return;
+    }
+    std::string text;
+    while (text.size() < static_cast<size_t>(state.range(0))) {
+        text += "user=svc-deploy host=build-" + std::to_string(text.size() % 97) + " token=abcdef0123456789\n";
+    }
+    text.resize(state.range(0));
+    size_t packedSize = 0;
+    for (auto _ : state) {
+        std::string copy = text;
+        Compression::pack(copy);
+        packedSize = copy.size();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+    state.counters["ratio"] = static_cast<double>(text.size()) / static_cast<double>(packedSize);
+}
+BENCHMARK(BM_PackText)->RangeMultiplier(16)->Range(1024, 16 << 20);
+
+// range(0) is the number of secrets already in the vault
+void BM_AddSecret(benchmark::State &state)
+{
+    TempVault vault(static_cast<int>(state.range(0)));
+    auto key = CryptoManager::generateRandomBytes(32);
+    auto iv = CryptoManager::generateRandomBytes(12);
+    auto blob = CryptoManager::encrypt("hunter2", key, iv);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(vault.db->addSecret(vault.userId, "new-site", blob, iv));
+    }
+}
+BENCHMARK(BM_AddSecret)->RangeMultiplier(10)->Range(10, 100000)->Unit(benchmark::kMicrosecond);
+
+void BM_GetSecrets(benchmark::State &state)
+{
+    TempVault vault(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(vault.db->getSecrets(vault.userId));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GetSecrets)->RangeMultiplier(10)->Range(10, 100000)->Unit(benchmark::kMicrosecond);
+
+// open + lookup, the whole cost for a process fetching one secret
+void BM_SnapshotOpenFind(benchmark::State &state)
+{
+    TempVault vault(static_cast<int>(state.range(0)));
+    auto path = tempPath("vault.snap").string();
+    VaultSnapshot::exportUser(*vault.db, "bench", path);
+    std::string title = "site-" + std::to_string(state.range(0) / 2);
+    for (auto _ : state) {
+        VaultSnapshot snapshot(path);
+        benchmark::DoNotOptimize(snapshot.find(title));
+    }
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_SnapshotOpenFind)->RangeMultiplier(10)->Range(10, 100000)->Unit(benchmark::kMicrosecond);
+
+} // namespace
+
+// lookups of random (absent) digests in an N-entry SHA-1 corpus
+void BM_BreachLookup(benchmark::State &state)
+{
+    auto text = tempPath("hibp.txt").string();
+    auto corpusPath = tempPath("hibp.bin").string();
+    {
+        std::set<std::string> lines;
+        for (int i = 0; static_cast<int64_t>(lines.size()) < state.range(0); ++i) {
+            auto digest = BreachCorpus::digest("password-" + std::to_string(i), BreachCorpus::HashKind::Sha1);
+            std::string line;
+            char hex[3];
+            for (uint8_t byte : digest) {
+                std::snprintf(hex, sizeof(hex), "%02X", byte);
+                line += hex;
+            }
+            lines.insert(line + ":1");
+        }
+        std::ofstream out(text);
+        for (const auto &line : lines) out << line << '\n';
+    }
+    BreachCorpus::build(text, corpusPath, BreachCorpus::HashKind::Sha1);
+    BreachCorpus corpus(corpusPath);
+    auto probe = CryptoManager::generateRandomBytes(20);
+    for (auto _ : state) {
+        probe[19]++;
+        benchmark::DoNotOptimize(corpus.occurrences(probe));
+    }
+    std::filesystem::remove(text);
+    std::filesystem::remove(corpusPath);
+}
+BENCHMARK(BM_BreachLookup)->RangeMultiplier(100)->Range(100, 1000000);
+
+// batches of 100000-iteration PBKDF2 derivations per MultiPbkdf2 kernel
+void BM_DeriveKeysBatch(benchmark::State &state)
+{
+    auto kernel = static_cast<MultiPbkdf2::Kernel>(state.range(0));
+    if (!MultiPbkdf2::available(kernel)) {
+        state.SkipWithError("kernel not available on this CPU");
+        return;
+    }
+    // timings of a kernel that derives wrong keys are meaningless
+    static const bool verified = MultiPbkdf2::selfTest();
+    if (!verified) {
+        state.SkipWithError("kernels disagree with OpenSSL");
+        return;
+    }
+    state.SetLabel(MultiPbkdf2::name(kernel));
+    std::vector<std::string> passwords;
+    std::vector<std::vector<uint8_t>> salts;
+    for (int64_t i = 0; i < state.range(1); ++i) {
+        passwords.push_back("password-" + std::to_string(i));
+        salts.push_back(CryptoManager::generateRandomBytes(16));
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(MultiPbkdf2::derive(passwords, salts, 100000, 32, kernel));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_DeriveKeysBatch)
+    ->ArgsProduct({{static_cast<int64_t>(MultiPbkdf2::Kernel::OpenSsl), static_cast<int64_t>(MultiPbkdf2::Kernel::Portable),
+                    static_cast<int64_t>(MultiPbkdf2::Kernel::ShaNi), static_cast<int64_t>(MultiPbkdf2::Kernel::Avx2),
+                    static_cast<int64_t>(MultiPbkdf2::Kernel::Avx512)},
+                   {16}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,404 @@
+// Concurrent load generator: simulated users registering, logging in,
+// adding and listing secrets against one database file, from several
+// threads and (on POSIX) several processes. Reports throughput, latency
+// percentiles and how often SQLite answered SQLITE_BUSY.
+//
+//   ./cryptify_loadgen --users 64 --threads 4 --procs 2 --seconds 10 --mix 1:4:10:5 --wal
+//
+// Every worker thread owns its own dataBase connection, as separate client
+// processes would.
+#include "CryptoManager.hpp"
+#include "KeyRotation.hpp"
+#include "dBase.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+enum Op { Register, Login, Add, List, OpCount };
+const char *const kOpNames[OpCount] = {"register", "login", "add", "list"};
+
+struct Options
+{
+    int users = 64;
+    int threads = 4;
+    int procs = 1;
+    double seconds = 10;
+    std::array<double, OpCount> mix{1, 4, 10, 5};
+    int busyTimeout = 0;
+    bool wal = false;
+    int secretBytes = 64;
+    std::string db;
+};
+
+struct Account
+{
+    std::string name;
+    std::string password;
+    int id;
+    std::vector<uint8_t> vaultKey;
+};
+
+struct OpStats
+{
+    std::vector<uint32_t> micros; // every attempt, failed ones included
+    uint64_t errors = 0;
+    uint64_t busy = 0;
+};
+using Stats = std::array<OpStats, OpCount>;
+
+void usage()
+{
+    std::fprintf(stderr,
+                 "usage: cryptify_loadgen [--users N] [--threads N] [--procs N] [--seconds S]\n"
+                 "                        [--mix register:login:add:list] [--busy-timeout MS]\n"
+                 "                        [--wal] [--secret-bytes N] [--db PATH]\n");
+}
+
+bool parseMix(const char *text, std::array<double, OpCount> &mix)
+{
+    double values[OpCount];
+    if (std::sscanf(text, "%lf:%lf:%lf:%lf", &values[0], &values[1], &values[2], &values[3]) != OpCount) return false;
+    double total = 0;
+    for (int i = 0; i < OpCount; ++i) {
+        if (values[i] < 0) return false;
+        mix[i] = values[i];
+        total += values[i];
+    }
+    return total > 0;
+}
+
+bool parseArgs(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--wal") {
+            options.wal = true;
+            continue;
+        }
+        if (!value) return false;
+        ++i;
+        if (arg == "--users") options.users = std::atoi(value);
+        else if (arg == "--threads") options.threads = std::atoi(value);
+        else if (arg == "--procs") options.procs = std::atoi(value);
+        else if (arg == "--seconds") options.seconds = std::atof(value);
+        else if (arg == "--busy-timeout") options.busyTimeout = std::atoi(value);
+        else if (arg == "--secret-bytes") options.secretBytes = std::atoi(value);
+        else if (arg == "--db") options.db = value;
+        else if (arg == "--mix") {
+            if (!parseMix(value, options.mix)) return false;
+        } else return false;
+    }
+    return options.users > 0 && options.threads > 0 && options.procs > 0 && options.seconds > 0 &&
+           options.secretBytes > 0 && options.busyTimeout >= 0;
+}
+
+bool isBusy(int code)
+{
+    code &= 0xff;
+    return code == SQLITE_BUSY || code == SQLITE_LOCKED;
+}
+
+// accounts every worker can log into; the vault key is kept so that add
+// does not pay for a key derivation on every call
+std::vector<Account> prepareAccounts(const Options &options)
+{
+    dataBase db(options.db);
+    std::vector<Account> accounts;
+    for (int i = 0; i < options.users; ++i) {
+        Account account{"user-" + std::to_string(i), "password-" + std::to_string(i), 0, {}};
+        auto salt = CryptoManager::generateRandomBytes(16);
+        auto keyIv = CryptoManager::generateRandomBytes(12);
+        account.vaultKey = CryptoManager::generateRandomBytes(32);
+        auto wrapped = CryptoManager::wrapKey(account.vaultKey, CryptoManager::deriveKey(account.password, salt), keyIv);
+        dataBase::UserQuerey user;
+        if (!db.addUser(account.name, CryptoManager::hashPassword(account.password, salt), salt, wrapped, keyIv) ||
+            !db.getUser(account.name, user)) {
+            throw std::runtime_error("Failed to create account " + account.name);
+        }
+        account.id = user.id;
+        accounts.push_back(std::move(account));
+    }
+    return accounts;
+}
+
+// the constructor's schema check is itself a read that can hit SQLITE_BUSY
+// while other workers are writing
+std::unique_ptr<dataBase> connect(const Options &options)
+{
+    for (int attempt = 0;; ++attempt) {
+        try {
+            auto db = std::make_unique<dataBase>(options.db);
+            db->setBusyTimeout(options.busyTimeout);
+            return db;
+        } catch (const std::runtime_error &) {
+            if (attempt == 1000) throw;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+void runWorker(const Options &options, const std::vector<Account> &accounts, int worker, Stats &stats)
+{
+    auto connection = connect(options);
+    dataBase &db = *connection;
+    std::mt19937 rng(static_cast<unsigned>(worker) * 7919u + 1);
+    std::discrete_distribution<int> pickOp(options.mix.begin(), options.mix.end());
+    std::uniform_int_distribution<size_t> pickAccount(0, accounts.size() - 1);
+    const std::string payload(options.secretBytes, 's');
+    const CipherSuite suite = CryptoManager::preferredSuite();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(options.seconds);
+    int serial = 0;
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        const int op = pickOp(rng);
+        const Account &account = accounts[pickAccount(rng)];
+        const std::string unique = std::to_string(worker) + "-" + std::to_string(serial++);
+        bool ok = false;
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            switch (op) {
+            case Register: {
+                auto salt = CryptoManager::generateRandomBytes(16);
+                std::vector<uint8_t> wrapped, keyIv;
+                KeyRotation::createVaultKey("password", salt, wrapped, keyIv);
+                ok = db.addUser("new-" + unique, CryptoManager::hashPassword("password", salt), salt, wrapped, keyIv);
+                break;
+            }
+            case Login: {
+                dataBase::UserQuerey user;
+                ok = db.getUser(account.name, user) && CryptoManager::hashPassword(account.password, user.salt) == user.hash;
+                if (ok) CryptoManager::openVaultKey(account.password, user.salt, user.wrappedKey, user.keyIv);
+                break;
+            }
+            case Add: {
+                auto iv = CryptoManager::generateRandomBytes(12);
+                auto data = CryptoManager::encrypt(suite, payload, account.vaultKey, iv);
+                ok = db.addSecret(account.id, "site-" + unique, data, iv, suite);
+                break;
+            }
+            case List: {
+                db.getSecrets(account.id);
+                // getSecrets returns an empty list on errors too
+                ok = db.lastError() == SQLITE_OK;
+                break;
+            }
+            }
+        } catch (const std::exception &) {
+            ok = false;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        OpStats &entry = stats[op];
+        entry.micros.push_back(static_cast<uint32_t>(
+            std::min<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), UINT32_MAX)));
+        if (!ok) {
+            ++entry.errors;
+            if (isBusy(db.lastError())) ++entry.busy;
+        }
+    }
+}
+
+Stats runThreads(const Options &options, const std::vector<Account> &accounts, int firstWorker)
+{
+    std::vector<Stats> perThread(options.threads);
+    {
+        std::vector<std::jthread> threads;
+        for (int t = 0; t < options.threads; ++t) {
+            threads.emplace_back([&, t] {
+                try {
+                    runWorker(options, accounts, firstWorker + t, perThread[t]);
+                } catch (const std::exception &e) {
+                    std::fprintf(stderr, "worker %d: %s\n", firstWorker + t, e.what());
+                }
+            });
+        }
+    }
+    Stats merged;
+    for (auto &stats : perThread) {
+        for (int op = 0; op < OpCount; ++op) {
+            auto &from = stats[op];
+            merged[op].micros.insert(merged[op].micros.end(), from.micros.begin(), from.micros.end());
+            merged[op].errors += from.errors;
+            merged[op].busy += from.busy;
+        }
+    }
+    return merged;
+}
+
+#ifndef _WIN32
+// child -> parent: per op <count><errors><busy> as uint64, then count uint32 samples
+bool writeAll(int fd, const void *data, size_t size)
+{
+    const char *p = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readAll(int fd, void *data, size_t size)
+{
+    char *p = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t n = ::read(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void sendStats(int fd, const Stats &stats)
+{
+    for (const auto &entry : stats) {
+        uint64_t header[3] = {entry.micros.size(), entry.errors, entry.busy};
+        writeAll(fd, header, sizeof(header));
+        writeAll(fd, entry.micros.data(), entry.micros.size() * sizeof(uint32_t));
+    }
+}
+
+bool receiveStats(int fd, Stats &merged)
+{
+    for (auto &entry : merged) {
+        uint64_t header[3];
+        if (!readAll(fd, header, sizeof(header))) return false;
+        size_t old = entry.micros.size();
+        entry.micros.resize(old + header[0]);
+        if (!readAll(fd, entry.micros.data() + old, header[0] * sizeof(uint32_t))) return false;
+        entry.errors += header[1];
+        entry.busy += header[2];
+    }
+    return true;
+}
+
+Stats runProcesses(const Options &options, const std::vector<Account> &accounts)
+{
+    std::vector<std::pair<pid_t, int>> children;
+    for (int p = 0; p < options.procs; ++p) {
+        int fds[2];
+        if (::pipe(fds) != 0) throw std::runtime_error("pipe failed");
+        pid_t pid = ::fork();
+        if (pid < 0) throw std::runtime_error("fork failed");
+        if (pid == 0) {
+            ::close(fds[0]);
+            sendStats(fds[1], runThreads(options, accounts, p * options.threads));
+            ::close(fds[1]);
+            std::_Exit(0);
+        }
+        ::close(fds[1]);
+        children.emplace_back(pid, fds[0]);
+    }
+    Stats merged;
+    for (auto [pid, fd] : children) {
+        if (!receiveStats(fd, merged)) std::fprintf(stderr, "lost results of process %d\n", static_cast<int>(pid));
+        ::close(fd);
+        ::waitpid(pid, nullptr, 0);
+    }
+    return merged;
+}
+#endif
+
+double percentile(const std::vector<uint32_t> &sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1] / 1000.0;
+}
+
+void report(Stats &stats, double seconds)
+{
+    std::printf("\n%-9s %9s %10s %9s %9s %9s %9s %8s %8s\n", "op", "count", "ops/s", "p50 ms", "p99 ms",
+                "p999 ms", "max ms", "errors", "busy");
+    uint64_t total = 0, busy = 0;
+    for (int op = 0; op < OpCount; ++op) {
+        auto &entry = stats[op];
+        std::sort(entry.micros.begin(), entry.micros.end());
+        total += entry.micros.size();
+        busy += entry.busy;
+        if (entry.micros.empty()) continue;
+        std::printf("%-9s %9zu %10.1f %9.3f %9.3f %9.3f %9.3f %8llu %8llu\n", kOpNames[op], entry.micros.size(),
+                    entry.micros.size() / seconds, percentile(entry.micros, 0.50), percentile(entry.micros, 0.99),
+                    percentile(entry.micros, 0.999), entry.micros.back() / 1000.0,
+                    static_cast<unsigned long long>(entry.errors), static_cast<unsigned long long>(entry.busy));
+    }
+    std::printf("\ntotal %llu ops, %.1f ops/s, SQLITE_BUSY on %.3f%% of calls\n", static_cast<unsigned long long>(total),
+                total / seconds, total ? 100.0 * busy / total : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+#ifdef _WIN32
+    if (options.procs > 1) {
+        std::fprintf(stderr, "--procs is not supported on Windows, using threads only\n");
+        options.procs = 1;
+    }
+#endif
+    const bool tempDb = options.db.empty();
+    if (tempDb) {
+        auto path = std::filesystem::temp_directory_path() / ("cryptify_loadgen-" + std::to_string(std::random_device{}()) + ".db");
+        options.db = path.string();
+    }
+
+    int rc = 0;
+    try {
+        if (options.wal) {
+            sqlite3 *raw = nullptr;
+            sqlite3_open(options.db.c_str(), &raw);
+            sqlite3_exec(raw, "PRAGMA journal_mode = WAL;", nullptr, nullptr, nullptr);
+            sqlite3_close(raw);
+        }
+        std::printf("preparing %d accounts in %s\n", options.users, options.db.c_str());
+        auto accounts = prepareAccounts(options);
+        std::printf("running %d process(es) x %d thread(s) for %.1fs, mix register:login:add:list = %g:%g:%g:%g%s\n",
+                    options.procs, options.threads, options.seconds, options.mix[Register], options.mix[Login],
+                    options.mix[Add], options.mix[List], options.wal ? ", WAL" : "");
+
+        const auto start = std::chrono::steady_clock::now();
+#ifndef _WIN32
+        Stats stats = options.procs > 1 ? runProcesses(options, accounts) : runThreads(options, accounts, 0);
+#else
+        Stats stats = runThreads(options, accounts, 0);
+#endif
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report(stats, elapsed);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "cryptify_loadgen: %s\n", e.what());
+        rc = 1;
+    }
+
+    if (tempDb) {
+        for (const char *suffix : {"", "-wal", "-shm", "-journal"}) {
+            std::error_code ignored;
+            std::filesystem::remove(options.db + suffix, ignored);
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stop_token>
+#include <string>
+
+// receives a finished backup in order, chunk by chunk; return false to abort
+using BackupSink = std::function<bool(const uint8_t *data, size_t size)>;
+// called after every backup step with the pages still to copy and the total;
+// return false to abort
+using BackupProgress = std::function<bool(int remaining, int total)>;
+
+struct BackupOptions
+{
+    int pagesPerStep = 256;  // pages copied while holding the connection, <= 0 copies all at once
+    int pauseMs = 10;        // connection released between steps so foreground calls get through
+    std::string passphrase;  // non-empty: the output is a BackupStream sealed under it
+    std::stop_token stop;    // cancels the backup at the next step or chunk, see stopBackups()
+};
+
+// Sealed backup format, written and read in fixed-size chunks so neither
+// side holds the whole database in memory:
+//
+//   "CRYBKUP1" | salt[16] | chunk...
+//   chunk = length[4, big endian] | IV[12] | ciphertext[length] | tag[16]
+//
+// AES-256-GCM under deriveKey(passphrase, salt). The associated data of a
+// chunk is its index and a last-chunk flag, so reordered, dropped or
+// truncated chunks fail authentication.
+class BackupStream
+{
+public:
+    static constexpr size_t kChunkBytes = 64 * 1024;
+
+    // sends the file at path to sink, sealed when passphrase is non-empty and
+    // as-is otherwise; false if the file cannot be read or the sink aborts
+    static bool write(const std::string &path, const std::string &passphrase, const BackupSink &sink);
+    // turns a sealed backup back into the database file it was made from;
+    // throws on a wrong passphrase or a damaged stream
+    static void unseal(const std::string &sealedPath, const std::string &passphrase, const std::string &destPath);
+};
+
+// Owner-only scratch directory for a staging copy, removed with everything
+// in it on destruction. The name carries the creating process id, so
+// removeStale() can clear what a crashed or killed process left behind;
+// dataBase calls it once per process when the first database is opened.
+class BackupStaging
+{
+public:
+    BackupStaging(); // throws if the directory cannot be created
+    ~BackupStaging();
+    BackupStaging(const BackupStaging &) = delete;
+    BackupStaging &operator=(const BackupStaging &) = delete;
+
+    const std::string &directory() const { return m_directory; }
+    std::string file(const std::string &name) const;
+
+    static void removeStale();
+
+private:
+    std::string m_directory;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include "MappedFile.hpp"
+#include "dBase.hpp"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Offline "has this password been breached" check against a local copy of a
+// HIBP-style corpus (SHA-1 or NTLM hashes with prevalence counts).
+//
+// The corpus is converted once by build() into a binary file that is
+// memory-mapped on open, so even multi-GB corpora cost no RAM up front:
+//   header   fixed 32 bytes, see BreachCorpus.cpp
+//   index    65537 uint64 offsets, entry range per 16-bit digest prefix
+//   entries  digest || uint32 count, sorted by digest
+// A lookup reads the index slot of the digest's first two bytes and runs an
+// interpolation search inside that bucket, touching a handful of pages.
+//
+// dataBase::addSecret only ever sees ciphertext, so callers check the
+// plaintext with occurrences() before encrypting; checkVault() covers
+// records that are already stored.
+class BreachCorpus
+{
+public:
+    enum class HashKind : uint8_t
+    {
+        Sha1 = 1, // pwned-passwords-sha1-ordered-by-hash
+        Ntlm = 2  // pwned-passwords-ntlm-ordered-by-hash
+    };
+    struct Finding
+    {
+        int secretId;
+        std::string title;
+        uint32_t occurrences;
+    };
+
+    explicit BreachCorpus(const std::string &path);
+
+    HashKind kind() const { return m_kind; }
+    size_t size() const { return m_count; }
+
+    // how often password appears in the corpus, 0 if it does not
+    uint32_t occurrences(std::string_view password) const;
+    uint32_t occurrences(std::span<const uint8_t> digest) const;
+    // SHA-1 of the bytes, or NTLM (MD4 of the UTF-16LE form) of the UTF-8 text
+    static std::vector<uint8_t> digest(std::string_view password, HashKind kind);
+
+    // decrypts every record of the user's vault and reports the breached ones
+    std::vector<Finding> checkVault(dataBase &db, int userId, const std::vector<uint8_t> &vaultKey) const;
+
+    // converts a HIBP download ("HEXDIGEST:COUNT" per line, sorted by hash)
+    // into the binary format; returns the number of entries written
+    static size_t build(const std::string &textPath, const std::string &outPath, HashKind kind);
+
+private:
+    MappedFile m_file;
+    HashKind m_kind;
+    size_t m_digestSize;
+    size_t m_entrySize;
+    size_t m_count = 0;
+    const uint8_t *m_index = nullptr;
+    const uint8_t *m_entries = nullptr;
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <openssl/evp.h>
+
+// AEAD used for a record. The id is stored per row in secrets.suite, so
+// values must never be reused.
+enum class CipherSuite : uint8_t
+{
+    Aes256Gcm = 1,
+    ChaCha20Poly1305 = 2
+};
+
+// Cipher policies for CryptoManager::encrypt<Suite> / decrypt<Suite>. Both
+// suites take a 32-byte key and 12-byte IV and produce a 16-byte tag, so the
+// stored format (ciphertext || tag, separate IV) is the same for either.
+struct Aes256GcmSuite
+{
+    static constexpr CipherSuite id = CipherSuite::Aes256Gcm;
+    static const EVP_CIPHER *cipher() { return EVP_aes_256_gcm(); }
+};
+
+struct ChaCha20Poly1305Suite
+{
+    static constexpr CipherSuite id = CipherSuite::ChaCha20Poly1305;
+    static const EVP_CIPHER *cipher() { return EVP_chacha20_poly1305(); }
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bits of secrets.flags describing how the plaintext was transformed before
+// encryption.
+enum RecordFlags : uint8_t
+{
+    RecordCompressed = 0x01 // zstd frame, undo with Compression::unpack
+};
+
+// Optional zstd compression of record plaintexts, applied before encryption
+// (ciphertext does not compress). Only available when built with zstd; a
+// build without it never sets RecordCompressed and refuses to open such
+// records.
+class Compression
+{
+public:
+    // records below this size are never worth the frame overhead
+    static constexpr size_t kDefaultThreshold = 1024;
+
+    static bool available();
+
+    // compresses plaintext in place if it is at least threshold bytes and
+    // actually shrinks; returns the RecordFlags to store with the record
+    static uint8_t pack(std::string &plaintext, size_t threshold = kDefaultThreshold, int level = 3);
+    // reverses pack for a decrypted record
+    static void unpack(std::vector<uint8_t> &plaintext, uint8_t flags);
+};
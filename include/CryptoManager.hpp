@@ -2,14 +2,43 @@
 #include <vector>
 #include <cstdint>
 #include <string>
+#include <string_view>
+#include "CipherSuite.hpp"
 class CryptoManager
 {
 public:
     static std::vector<uint8_t> generateRandomBytes(int size);
     static std::vector<uint8_t> hashPassword(const std::string &password, const std::vector<uint8_t> &salt);
     static std::vector<uint8_t> deriveKey(const std::string &pass, const std::vector<uint8_t> &salt);
+    // deriveKey for many (pass, salt) pairs at once on the SIMD kernels of
+    // MultiPbkdf2; same keys, a fraction of the time per key on bulk jobs
+    static std::vector<std::vector<uint8_t>> deriveKeys(const std::vector<std::string> &passes, const std::vector<std::vector<uint8_t>> &salts);
     static std::vector<uint8_t> encrypt(const std::string &plaintext, const std::vector<uint8_t> &key, const std::vector<uint8_t> &iv);
     static std::vector<uint8_t> decrypt(const std::vector<uint8_t> &cipherText, const std::vector<uint8_t> &key, const std::vector<uint8_t> &iv);
 
+    // AEAD picked at compile time: encrypt<ChaCha20Poly1305Suite>(...). The
+    // overloads above are encrypt<Aes256GcmSuite> / decrypt<Aes256GcmSuite>.
+    template <typename Suite>
+    static std::vector<uint8_t> encrypt(std::string_view plaintext, const std::vector<uint8_t> &key, const std::vector<uint8_t> &iv);
+    template <typename Suite>
+    static std::vector<uint8_t> decrypt(const std::vector<uint8_t> &cipherText, const std::vector<uint8_t> &key, const std::vector<uint8_t> &iv);
+    // AEAD picked at runtime, e.g. from secrets.suite
+    static std::vector<uint8_t> encrypt(CipherSuite suite, const std::string &plaintext, const std::vector<uint8_t> &key, const std::vector<uint8_t> &iv);
+    static std::vector<uint8_t> decrypt(CipherSuite suite, const std::vector<uint8_t> &cipherText, const std::vector<uint8_t> &key, const std::vector<uint8_t> &iv);
+    // re-encrypts what decrypt returned without copying it into a string first
+    static std::vector<uint8_t> encrypt(CipherSuite suite, const std::vector<uint8_t> &plaintext, const std::vector<uint8_t> &key, const std::vector<uint8_t> &iv);
+    // AES-256-GCM on hosts with AES instructions, ChaCha20-Poly1305 elsewhere
+    static CipherSuite preferredSuite();
+    static bool hasAesHardware();
+
+    // envelope encryption: records are encrypted under a random vault key,
+    // which is stored wrapped (AES-GCM) by the password-derived key
+    static std::vector<uint8_t> wrapKey(const std::vector<uint8_t> &vaultKey, const std::vector<uint8_t> &kek, const std::vector<uint8_t> &iv);
+    static std::vector<uint8_t> unwrapKey(const std::vector<uint8_t> &wrappedKey, const std::vector<uint8_t> &kek, const std::vector<uint8_t> &iv);
+    // returns the key that encrypts the user's records; accounts without a
+    // wrapped key still use the password-derived key directly
+    static std::vector<uint8_t> openVaultKey(const std::string &pass, const std::vector<uint8_t> &salt,
+                                             const std::vector<uint8_t> &wrappedKey, const std::vector<uint8_t> &keyIv);
+
 private:
 };
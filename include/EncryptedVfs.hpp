@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// SQLite VFS shim that encrypts the database file page by page with
+// AES-256-GCM, so titles, indexes and free pages are protected at rest while
+// SQLite keeps working on plaintext pages in its cache.
+//
+// Every page reserves kReserveBytes at its end (SQLITE_FCNTL_RESERVE_BYTES)
+// for a random 12-byte IV and the 16-byte tag; page 1 also keeps the KDF
+// salt there. The first 100 bytes of page 1 (the SQLite header, which holds
+// no user data) stay readable so SQLite can learn the page size, and are
+// authenticated as associated data. Page images in the rollback journal and
+// the WAL are encrypted the same way; temp files are kept in memory by the
+// connection (temp_store=MEMORY).
+//
+// Each instance registers its own uniquely named VFS over the default one
+// and unregisters it on destruction; see dataBase(path, passphrase).
+class EncryptedVfs
+{
+public:
+    static constexpr int kReserveBytes = 48;
+    static constexpr int kSaltBytes = 16;
+
+    EncryptedVfs(const std::vector<uint8_t> &key, const std::vector<uint8_t> &salt);
+    ~EncryptedVfs();
+    EncryptedVfs(const EncryptedVfs &) = delete;
+    EncryptedVfs &operator=(const EncryptedVfs &) = delete;
+
+    const char *name() const;
+
+    // KDF salt stored in an existing encrypted database; empty if the file
+    // does not exist yet. Throws if the file is a plaintext database.
+    static std::vector<uint8_t> readSalt(const std::string &path);
+
+    struct State;
+
+private:
+    std::unique_ptr<State> m_state;
+};
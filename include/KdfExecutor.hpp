@@ -0,0 +1,89 @@
+#pragma once
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Thrown when the KDF queue is full and a request is shed.
+class KdfOverloaded : public std::runtime_error
+{
+public:
+    KdfOverloaded() : std::runtime_error("KDF queue is full, try again later") {}
+};
+
+// Runs password-based key derivations on a fixed number of worker threads
+// behind a bounded queue, so a burst of logins cannot occupy every core and
+// stall the cheap vault reads. Requests beyond the queue capacity are
+// rejected immediately with KdfOverloaded instead of waiting.
+//
+//   auto key = executor.deriveKey(password, salt).get();
+//   auto key = co_await executor.deriveKeyAsync(password, salt,
+//                                               [&loop](auto handle) { loop.post(handle); });
+class KdfExecutor
+{
+public:
+    using Work = std::move_only_function<std::vector<uint8_t>()>;
+    // hands a suspended coroutine back to the caller's executor (event loop,
+    // thread pool) to be resumed there
+    using Resume = std::move_only_function<void(std::coroutine_handle<>)>;
+
+    KdfExecutor(unsigned workers, size_t queueCapacity);
+    ~KdfExecutor(); // finishes queued work, then joins
+    KdfExecutor(const KdfExecutor &) = delete;
+    KdfExecutor &operator=(const KdfExecutor &) = delete;
+
+    // process-wide executor: half the cores, 64 queued requests per worker
+    static KdfExecutor &shared();
+
+    // any KDF-bound job, e.g. CryptoManager::openVaultKey; an empty work
+    // throws std::invalid_argument
+    std::future<std::vector<uint8_t>> submit(Work work);
+    std::future<std::vector<uint8_t>> deriveKey(std::string pass, std::vector<uint8_t> salt);
+
+    class KeyAwaiter
+    {
+    public:
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        std::vector<uint8_t> await_resume();
+
+    private:
+        friend class KdfExecutor;
+        KeyAwaiter(KdfExecutor &executor, std::string pass, std::vector<uint8_t> salt, Resume resume);
+        KdfExecutor &m_executor;
+        Resume m_resume;
+        std::string m_pass;
+        std::vector<uint8_t> m_salt;
+        std::vector<uint8_t> m_key;
+        std::exception_ptr m_error;
+    };
+    // once the key is ready the worker passes the awaiting coroutine to
+    // resume instead of running it, so whatever follows the co_await never
+    // occupies a KDF worker; a shed request continues inline and throws.
+    // An empty resume throws std::invalid_argument here. resume must not
+    // throw: the worker logs the exception and the coroutine is never resumed.
+    KeyAwaiter deriveKeyAsync(std::string pass, std::vector<uint8_t> salt, Resume resume);
+
+    size_t queued() const;
+    uint64_t rejected() const;
+
+private:
+    bool tryEnqueue(std::move_only_function<void()> job);
+    void run();
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_ready;
+    std::deque<std::move_only_function<void()>> m_queue;
+    size_t m_capacity;
+    uint64_t m_rejected = 0;
+    bool m_stopping = false;
+    std::vector<std::thread> m_workers;
+};
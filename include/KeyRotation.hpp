@@ -0,0 +1,69 @@
+#pragma once
+#include "dBase.hpp"
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+struct RotationOptions
+{
+    int batchSize = 256;                                  // rows re-encrypted and committed per transaction
+    unsigned workers = std::thread::hardware_concurrency(); // 0 falls back to a single worker
+};
+
+// an interrupted rotation to another password blocks this one, see abortRotation
+class RotationPending : public std::runtime_error
+{
+public:
+    RotationPending() : std::runtime_error("A different key rotation is already in progress") {}
+};
+
+struct RotationResult
+{
+    int reEncrypted = 0;
+    int batches = 0;
+    bool resumed = false; // true when an interrupted rotation was picked up again
+};
+
+// Key management for a user's vault.
+//
+// Secrets are encrypted under a random vault key that is stored wrapped by
+// the password-derived key, so changePassword normally only re-wraps that
+// key. Re-encrypting records is needed when the vault key itself is
+// replaced (rotateVaultKey) and once for accounts created before envelope
+// encryption, whose records still sit under the password-derived key.
+//
+// Re-encryption is done in batches: every batch is decrypted and
+// re-encrypted across worker threads, then written back in its own
+// transaction together with the rotation cursor, so the database is never
+// locked for the whole run and a crashed rotation resumes where it stopped
+// when called again with the same passwords.
+//
+// Until a rotation finishes, the records up to its cursor are under the new
+// vault key while the stored credentials still open the old one: reading
+// them with the old key fails authentication, and the C API refuses them
+// with CRYPTIFY_ERR_ROTATING. Resume with the same new password, or call
+// abortRotation with the current password to move those records back and
+// drop the rotation; a different new password throws RotationPending.
+//
+// Key derivations run on KdfExecutor::shared() and throw KdfOverloaded when
+// its queue is full; do not call these from a KDF job.
+class KeyRotation
+{
+public:
+    // creates and wraps a fresh vault key for a new account
+    static void createVaultKey(const std::string &password, const std::vector<uint8_t> &salt,
+                               std::vector<uint8_t> &outWrappedKey, std::vector<uint8_t> &outKeyIv);
+
+    static RotationResult changePassword(dataBase &db, const std::string &username,
+                                         const std::string &oldPassword, const std::string &newPassword,
+                                         const RotationOptions &options = RotationOptions{});
+    static RotationResult rotateVaultKey(dataBase &db, const std::string &username, const std::string &password,
+                                         const RotationOptions &options = RotationOptions{});
+    // re-encrypts the records already moved back to the current vault key and
+    // drops the rotation, keeping password's credentials; resumable like a
+    // rotation if interrupted. newPassword is only needed for rotations begun
+    // before rollback keys were recorded.
+    static RotationResult abortRotation(dataBase &db, const std::string &username, const std::string &password,
+                                        const std::string &newPassword = {},
+                                        const RotationOptions &options = RotationOptions{});
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <sstream>
+#include <string_view>
+
+enum class LogLevel : int
+{
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warn = 3,
+    Error = 4,
+    Off = 5
+};
+
+// Messages below CRYPTIFY_LOG_LEVEL are removed at compile time, so the
+// per-call Debug/Trace messages in the hot path cost nothing in normal
+// builds. Everything at or above it can still be filtered at runtime.
+#ifndef CRYPTIFY_LOG_LEVEL
+#define CRYPTIFY_LOG_LEVEL 2
+#endif
+
+class Log
+{
+public:
+    static void setLevel(LogLevel level);
+    static bool enabled(LogLevel level)
+    {
+        return static_cast<int>(level) >= s_level.load(std::memory_order_relaxed);
+    }
+    static void write(LogLevel level, std::string_view message);
+
+private:
+    static std::atomic<int> s_level;
+};
+
+// CRYPTIFY_LOG(LogLevel::Debug, "found user " << id);
+#define CRYPTIFY_LOG(level, expr)                                          \
+    do {                                                                   \
+        if constexpr (static_cast<int>(level) >= CRYPTIFY_LOG_LEVEL) {     \
+            if (Log::enabled(level)) {                                     \
+                std::ostringstream cryptify_log_stream;                    \
+                cryptify_log_stream << expr;                               \
+                Log::write(level, cryptify_log_stream.str());              \
+            }                                                              \
+        }                                                                  \
+    } while (0)
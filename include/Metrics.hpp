@@ -0,0 +1,75 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Operations timed on the hot path.
+enum class MetricOp : int
+{
+    Kdf = 0,
+    Encrypt,
+    Decrypt,
+    Prepare,
+    Step,
+    Commit,
+    Count
+};
+
+// Per-operation counters and latency histograms.
+//
+// Every thread records into its own shard, written only by that thread with
+// relaxed atomics, so recording never takes a lock or bounces a cache line.
+// Dumps sum all shards; shards of exited threads are handed to new threads,
+// so counts stay cumulative for the whole process.
+//
+// Build with CRYPTIFY_METRICS=0 to compile recording out entirely.
+#ifndef CRYPTIFY_METRICS
+#define CRYPTIFY_METRICS 1
+#endif
+
+class Metrics
+{
+public:
+    // bucket i counts latencies in [2^i, 2^(i+1)) nanoseconds
+    static constexpr int kBuckets = 40;
+
+    struct OpStats
+    {
+        uint64_t count = 0;
+        uint64_t totalNanos = 0;
+        uint64_t buckets[kBuckets] = {};
+    };
+
+    static void record(MetricOp op, uint64_t nanos);
+    static OpStats snapshot(MetricOp op);
+    static void reset();
+
+    static std::string prometheus();
+    static std::string json();
+
+    static const char *name(MetricOp op);
+};
+
+// Times its own lifetime into the given operation.
+class ScopedTimer
+{
+public:
+#if CRYPTIFY_METRICS
+    explicit ScopedTimer(MetricOp op) : m_op(op), m_start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - m_start;
+        Metrics::record(m_op, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+#else
+    explicit ScopedTimer(MetricOp) {}
+#endif
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+#if CRYPTIFY_METRICS
+    MetricOp m_op;
+    std::chrono::steady_clock::time_point m_start;
+#endif
+};
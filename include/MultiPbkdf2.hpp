@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// PBKDF2-HMAC-SHA256 for many independent (password, salt) pairs at once,
+// for bulk jobs such as re-deriving every user's key after a KDF parameter
+// change or verifying a batch of credentials.
+//
+// The HMAC pads are hashed once per password and the first block with
+// OpenSSL; the iteration loop, which is all of the cost, then runs in one
+// of these kernels:
+//   Avx512    16 derivations per core in the lanes of 512-bit registers
+//   Avx2      8 derivations in 256-bit registers
+//   ShaNi     one derivation at a time on the SHA extensions
+//   Portable  one derivation at a time in plain C++
+//   OpenSsl   PKCS5_PBKDF2_HMAC per pair, the reference the others must match
+// best() picks by CPUID at runtime, in the order Avx512, Avx2, ShaNi, and
+// returns OpenSsl instead if selfTest(), run on its first call, fails. The SIMD
+// kernels are built with GCC/Clang target attributes on x86 and are reported
+// unavailable elsewhere. The last one or two derivations of a batch that do
+// not fill a register run on ShaNi when present, else Portable.
+class MultiPbkdf2
+{
+public:
+    enum class Kernel
+    {
+        OpenSsl,
+        Portable,
+        ShaNi,
+        Avx2,
+        Avx512
+    };
+
+    static bool available(Kernel kernel);
+    static Kernel best();
+    static const char *name(Kernel kernel);
+
+    // one keyLength-byte key per (passwords[i], salts[i])
+    static std::vector<std::vector<uint8_t>> derive(const std::vector<std::string> &passwords,
+                                                    const std::vector<std::vector<uint8_t>> &salts,
+                                                    uint32_t iterations, size_t keyLength = 32,
+                                                    Kernel kernel = best());
+
+    // compares every available kernel bit for bit against OpenSsl
+    static bool selfTest();
+};
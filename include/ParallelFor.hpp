@@ -0,0 +1,44 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// Runs body(i) for every i in [0, count) on up to `workers` threads, the
+// calling thread included. Threads pull indices from a shared counter, so
+// uneven items balance out. After the first exception no new indices are
+// started; it is rethrown on the caller once every thread has joined.
+template <typename Body>
+void parallelFor(size_t count, unsigned workers, Body &&body)
+{
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    auto work = [&]() {
+        size_t i;
+        while (!failed.load(std::memory_order_relaxed) && (i = next.fetch_add(1)) < count) {
+            try {
+                body(i);
+            } catch (...) {
+                if (!failed.exchange(true)) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    unsigned threadCount = static_cast<unsigned>(std::min<size_t>(std::max(workers, 1u), count));
+    std::vector<std::jthread> threads;
+    for (unsigned t = 1; t < threadCount; ++t) {
+        threads.emplace_back(work);
+    }
+    work();
+    threads.clear(); // joins
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
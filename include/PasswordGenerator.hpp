@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CSPRNG output read from OpenSSL in large blocks, so that generating a
+// password costs one RAND_bytes call per few hundred characters instead of
+// one per character. Not thread-safe; use one stream per thread.
+class RandomStream
+{
+public:
+    explicit RandomStream(size_t bufferSize = 4096);
+    ~RandomStream();
+    RandomStream(const RandomStream &) = delete;
+    RandomStream &operator=(const RandomStream &) = delete;
+
+    uint8_t nextByte();
+    uint32_t nextWord();
+    // uniform in [0, bound) by rejection sampling, no modulo bias
+    uint32_t uniform(uint32_t bound);
+
+private:
+    void refill();
+    std::vector<uint8_t> m_buffer;
+    size_t m_pos;
+};
+
+struct PasswordPolicy
+{
+    size_t length = 20;
+    bool lower = true;
+    bool upper = true;
+    bool digits = true;
+    bool symbols = true;
+    std::string symbolSet = "!@#$%^&*()-_=+[]{};:,.?/";
+    bool excludeAmbiguous = false; // drops 0 O o 1 l I | from every class
+    bool requireEachClass = true;  // at least one character of every enabled class
+};
+
+struct PassphrasePolicy
+{
+    size_t words = 6;
+    std::string separator = "-";
+    bool capitalize = false;
+    bool appendDigit = false; // one random digit after a random word
+};
+
+// Random passwords from a character-class policy. Every character is drawn
+// uniformly from the combined alphabet; requireEachClass rejects and redraws
+// whole passwords, which keeps the result uniform over the passwords that
+// satisfy the policy.
+class PasswordGenerator
+{
+public:
+    explicit PasswordGenerator(const PasswordPolicy &policy = PasswordPolicy{});
+
+    std::string generate();
+    // count passwords from one stream, for bulk provisioning
+    std::vector<std::string> generate(size_t count);
+    // upper bound, ignoring the requireEachClass rejection
+    double entropyBits() const;
+
+private:
+    PasswordPolicy m_policy;
+    std::string m_alphabet;
+    std::vector<std::string> m_classes;
+    RandomStream m_random;
+};
+
+// Diceware-style passphrases from a wordlist.
+class PassphraseGenerator
+{
+public:
+    PassphraseGenerator(std::vector<std::string> wordlist, const PassphrasePolicy &policy = PassphrasePolicy{});
+
+    std::string generate();
+    std::vector<std::string> generate(size_t count);
+    double entropyBits() const;
+
+    // one word per line; diceware lists ("11111<TAB>word") keep the last
+    // field. Duplicates and blank lines are dropped.
+    static std::vector<std::string> loadWordlist(const std::string &path);
+
+private:
+    std::vector<std::string> m_words;
+    PassphrasePolicy m_policy;
+    RandomStream m_random;
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include "dBase.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Users spread over N SQLite files so writers of different users do not
+// serialize on one database lock. A user lives on the shard picked by a
+// stable hash of the username; ids handed out by the router encode the
+// shard (globalId = localId * N + shard), so calls that only get a user id
+// route without a lookup. Secret ids in returned records are encoded the
+// same way. Encoded ids stay ints, so a shard serves local ids up to
+// INT_MAX / N; getUser and getSecrets fail rather than wrap beyond that.
+//
+// Shards are opened on first use as <base>.shard<k><ext>, e.g.
+// cryptify.shard3.db. The shard count is part of the data layout and must
+// not change for an existing deployment. Safe to share between threads:
+// each shard has its own connection and lock.
+class ShardedDatabase
+{
+public:
+    ShardedDatabase(const std::string &basePath, unsigned shards);
+    ~ShardedDatabase();
+    ShardedDatabase(const ShardedDatabase &) = delete;
+    ShardedDatabase &operator=(const ShardedDatabase &) = delete;
+
+    bool addUser(const std::string &username, const std::vector<uint8_t> &hash, const std::vector<uint8_t> &salt,
+                 const std::vector<uint8_t> &wrappedKey = {}, const std::vector<uint8_t> &keyIv = {});
+    bool getUser(const std::string &username, dataBase::UserQuerey &outData);
+    bool addSecret(int userId, const std::string &title, const std::vector<uint8_t> &encryptedData, const std::vector<uint8_t> &iv,
+                   CipherSuite suite = CipherSuite::Aes256Gcm, uint8_t flags = 0);
+    std::vector<dataBase::secretRecord> getSecrets(int userId);
+
+    unsigned shardCount() const;
+    unsigned shardOf(const std::string &username) const;
+    std::string shardPath(unsigned shard) const;
+
+private:
+    struct Shard;
+    dataBase &open(Shard &shard, unsigned index);
+    bool globalId(int localId, unsigned shard, int &outId) const;
+
+    std::string m_basePath;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+};
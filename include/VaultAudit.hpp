@@ -0,0 +1,74 @@
+#pragma once
+#include "dBase.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+class BreachCorpus;
+
+// Bits of AuditFinding::flags.
+enum AuditFlags : uint8_t
+{
+    AuditReused = 0x01,     // same password as another current record
+    AuditWeak = 0x02,       // score below AuditOptions::weakScore
+    AuditOld = 0x04,        // older than AuditOptions::maxAgeDays
+    AuditBreached = 0x08,   // found in AuditOptions::breaches
+    AuditUnreadable = 0x10  // did not decrypt with the given vault key
+};
+
+struct AuditOptions
+{
+    int batchSize = 256;                                    // records paged in and decrypted at a time
+    unsigned workers = std::thread::hardware_concurrency(); // 0 falls back to a single worker
+    int weakScore = 2;                                      // scores below this are weak
+    int64_t maxAgeDays = 365;
+    const BreachCorpus *breaches = nullptr;                 // optional offline breach check
+};
+
+struct AuditFinding
+{
+    int secretId;
+    std::string title;
+    uint8_t flags;     // AuditFlags, 0 for a healthy record
+    int score;         // 0 (trivial) .. 4 (strong)
+    double entropyBits;
+    int64_t ageDays;   // -1 when the record predates created_at
+    int reuseCount;    // current records sharing this password, including this one
+    uint32_t breachCount;
+};
+
+struct AuditSummary
+{
+    int records = 0;
+    int reused = 0;
+    int weak = 0;
+    int old = 0;
+    int breached = 0;
+    int unreadable = 0;
+};
+
+// Health check of one user's vault: password reuse, strength, age and
+// (optionally) presence in a breach corpus.
+//
+// Records are paged in batches and decrypted across worker threads; every
+// plaintext is scored and then wiped before the worker moves on, so at most
+// one plaintext per worker is alive at a time. Reuse is detected by
+// comparing HMAC-SHA256 tags under a random key that exists only for the
+// run, so the kept tags cannot be matched against guesses afterwards.
+// Only the newest record per title counts; older versions are history.
+// Findings for every current record are streamed to the callback once the
+// whole vault has been read (reuse needs all tags), in id order.
+class VaultAudit
+{
+public:
+    static AuditSummary run(dataBase &db, int userId, const std::vector<uint8_t> &vaultKey,
+                            const std::function<void(const AuditFinding &)> &onFinding,
+                            const AuditOptions &options = AuditOptions{});
+
+    // entropy estimate in bits and score 0..4: character pool, with
+    // repeated characters and runs such as "abc" or "321" discounted
+    static int score(std::string_view password, double *entropyBits = nullptr);
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include "CipherSuite.hpp"
+#include "MappedFile.hpp"
+#include "dBase.hpp"
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable, memory-mapped export of one user's vault for read-mostly
+// consumers such as build agents. Opening a snapshot maps the file and
+// checks the header; a lookup is a binary search over a sorted title index
+// and returns views straight into the mapping, so there is no SQLite, no
+// schema setup and no parsing on the read path.
+//
+// File layout (little-endian):
+//   header     fixed 64 bytes, see VaultSnapshot.cpp
+//   key block  salt || wrapped vault key || key IV, for unlock()
+//   index      count entries of 32 bytes, sorted by title bytes
+//   strings    titles, referenced by the index
+//   data       IV || ciphertext per record, referenced by the index
+//
+// Snapshots contain only ciphertext and the wrapped key, like the database.
+class VaultSnapshot
+{
+public:
+    struct Entry
+    {
+        std::string_view title;
+        std::span<const uint8_t> iv;
+        std::span<const uint8_t> ciphertext;
+        CipherSuite suite;
+        uint8_t flags;
+    };
+
+    // writes username's newest record per title to path (via a temp file,
+    // fsync and an atomic replace, so readers never see a partial snapshot);
+    // false while a key rotation of the user is unfinished
+    static bool exportUser(dataBase &db, const std::string &username, const std::string &path);
+
+    explicit VaultSnapshot(const std::string &path);
+
+    size_t size() const { return m_count; }
+    std::optional<Entry> find(std::string_view title) const;
+
+    // vault key from the password, same as logging in against the database
+    std::vector<uint8_t> unlock(const std::string &password) const;
+    // decrypted (and decompressed) record
+    static std::vector<uint8_t> open(const Entry &entry, const std::vector<uint8_t> &vaultKey);
+
+private:
+    Entry entryAt(size_t index) const;
+
+    MappedFile m_file;
+    size_t m_count = 0;
+    std::span<const uint8_t> m_salt, m_wrappedKey, m_keyIv;
+    const uint8_t *m_index = nullptr;
+    std::span<const uint8_t> m_strings, m_data;
+};
@@ -0,0 +1,123 @@
+/*
+ * Cryptify C API
+ *
+ * Stable C ABI over the vault engine (CryptoManager + dataBase) for
+ * in-process callers. A cryptify_vault keeps its database connection and,
+ * after cryptify_login, the unlocked vault key, so repeated operations pay
+ * neither process spawn, database open nor key derivation again.
+ *
+ * Calls on one handle are serialized internally; use one handle per user
+ * session. Buffers returned through out-parameters are owned by the caller
+ * and released with cryptify_free / cryptify_free_titles.
+ */
+#ifndef CRYPTIFY_H
+#define CRYPTIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(CRYPTIFY_SHARED)
+#  if defined(CRYPTIFY_BUILDING)
+#    define CRYPTIFY_API __declspec(dllexport)
+#  else
+#    define CRYPTIFY_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__)
+#  define CRYPTIFY_API __attribute__((visibility("default")))
+#else
+#  define CRYPTIFY_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* bumped whenever a declaration in this header changes incompatibly */
+#define CRYPTIFY_ABI_VERSION 1
+
+typedef struct cryptify_vault cryptify_vault;
+
+typedef enum cryptify_status
+{
+    CRYPTIFY_OK = 0,
+    CRYPTIFY_ERR_ARGUMENT = 1,  /* null handle/pointer or empty string */
+    CRYPTIFY_ERR_DATABASE = 2,  /* open or query failed */
+    CRYPTIFY_ERR_AUTH = 3,      /* unknown user or wrong password */
+    CRYPTIFY_ERR_EXISTS = 4,    /* username already taken */
+    CRYPTIFY_ERR_NOT_FOUND = 5, /* no secret with that title */
+    CRYPTIFY_ERR_LOCKED = 6,    /* operation needs cryptify_login first */
+    CRYPTIFY_ERR_CRYPTO = 7,    /* decryption/verification failed */
+    CRYPTIFY_ERR_NO_MEMORY = 8,
+    CRYPTIFY_ERR_BUSY = 9,      /* too many concurrent logins, retry later */
+    CRYPTIFY_ERR_ROTATING = 10  /* interrupted key rotation, see cryptify_abort_rotation */
+} cryptify_status;
+
+CRYPTIFY_API uint32_t cryptify_abi_version(void);
+CRYPTIFY_API const char *cryptify_status_string(cryptify_status status);
+
+/* opens (and creates if needed) the vault database at path */
+CRYPTIFY_API cryptify_status cryptify_open(const char *path, cryptify_vault **out_vault);
+/* wipes the unlocked key and closes the database; accepts NULL */
+CRYPTIFY_API void cryptify_close(cryptify_vault *vault);
+
+CRYPTIFY_API cryptify_status cryptify_register(cryptify_vault *vault, const char *username, const char *password);
+/* verifies the password and keeps the vault key unlocked on the handle.
+   Key derivation for register, login, change_password and snapshot unlock
+   runs on a shared, bounded KDF pool; when its queue is full the call fails
+   fast with CRYPTIFY_ERR_BUSY. */
+CRYPTIFY_API cryptify_status cryptify_login(cryptify_vault *vault, const char *username, const char *password);
+CRYPTIFY_API void cryptify_logout(cryptify_vault *vault);
+CRYPTIFY_API cryptify_status cryptify_change_password(cryptify_vault *vault, const char *username,
+                                                      const char *old_password, const char *new_password);
+/* A password change that re-encrypts records (legacy accounts) and is
+   interrupted leaves the records it already moved readable only under the
+   new password: cryptify_get_secret and cryptify_snapshot_export return
+   CRYPTIFY_ERR_ROTATING until cryptify_change_password is repeated with the
+   same new password, and a different one fails with CRYPTIFY_ERR_ROTATING.
+   cryptify_abort_rotation moves those records back under the current
+   password instead. */
+CRYPTIFY_API cryptify_status cryptify_abort_rotation(cryptify_vault *vault, const char *username, const char *password);
+
+/* the following require a logged-in handle */
+CRYPTIFY_API cryptify_status cryptify_add_secret(cryptify_vault *vault, const char *title,
+                                                 const uint8_t *data, size_t length);
+/* options for cryptify_add_secret_ex */
+#define CRYPTIFY_COMPRESS 0x1u /* zstd-compress before encryption if >= 1 KiB and it helps */
+
+CRYPTIFY_API cryptify_status cryptify_add_secret_ex(cryptify_vault *vault, const char *title,
+                                                    const uint8_t *data, size_t length, uint32_t options);
+CRYPTIFY_API cryptify_status cryptify_get_secret(cryptify_vault *vault, const char *title,
+                                                 uint8_t **out_data, size_t *out_length);
+CRYPTIFY_API cryptify_status cryptify_list_titles(cryptify_vault *vault, char ***out_titles, size_t *out_count);
+
+/* Read-only vault snapshots (VaultSnapshot.hpp): an mmap-able export of one
+   user's vault that opens without SQLite. Opening unlocks it with the
+   account password; lookups are a binary search over the mapped index. */
+typedef struct cryptify_snapshot cryptify_snapshot;
+
+CRYPTIFY_API cryptify_status cryptify_snapshot_export(cryptify_vault *vault, const char *username, const char *path);
+CRYPTIFY_API cryptify_status cryptify_snapshot_open(const char *path, const char *password,
+                                                    cryptify_snapshot **out_snapshot);
+CRYPTIFY_API cryptify_status cryptify_snapshot_get(cryptify_snapshot *snapshot, const char *title,
+                                                   uint8_t **out_data, size_t *out_length);
+/* wipes the unlocked key and unmaps the file; accepts NULL */
+CRYPTIFY_API void cryptify_snapshot_close(cryptify_snapshot *snapshot);
+
+typedef enum cryptify_metrics_format
+{
+    CRYPTIFY_METRICS_PROMETHEUS = 0,
+    CRYPTIFY_METRICS_JSON = 1
+} cryptify_metrics_format;
+
+/* process-wide latency histograms for kdf, encrypt, decrypt, prepare, step
+   and commit as a NUL-terminated string; release with cryptify_free */
+CRYPTIFY_API cryptify_status cryptify_metrics(cryptify_metrics_format format, char **out_text);
+
+CRYPTIFY_API void cryptify_free(void *buffer);
+CRYPTIFY_API void cryptify_free_titles(char **titles, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRYPTIFY_H */
@@ -4,6 +4,13 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "Backup.hpp"
+#include "CipherSuite.hpp"
+
+class EncryptedVfs;
 
 class dataBase
 {
@@ -13,24 +20,124 @@ public:
         int id;
         std::vector<uint8_t> hash;
         std::vector<uint8_t> salt;
+        // random vault key wrapped by deriveKey(password, salt); empty for
+        // accounts created before envelope encryption
+        std::vector<uint8_t> wrappedKey;
+        std::vector<uint8_t> keyIv;
     };
     struct secretRecord
     {
+        int id;
         std::string title;
         std::vector<uint8_t> encryptedData;
         std::vector<uint8_t> iv;
+        CipherSuite suite = CipherSuite::Aes256Gcm;
+        uint8_t flags = 0; // RecordFlags, see Compression.hpp
+        int64_t createdAt = 0; // unix seconds, 0 for records written before the column existed
+    };
+    // pending password change, see KeyRotation
+    struct rotationState
+    {
+        std::vector<uint8_t> newHash;
+        std::vector<uint8_t> newSalt;
+        std::vector<uint8_t> newWrappedKey;
+        std::vector<uint8_t> newKeyIv;
+        int lastSecretId; // every secret with id <= lastSecretId is already under the new key
+        // the new vault key wrapped by the current one, so an abort needs only
+        // the current password; empty for rotations begun before the column existed
+        std::vector<uint8_t> rollbackWrappedKey;
+        std::vector<uint8_t> rollbackKeyIv;
+    };
+    enum class ChangeOp : uint8_t
+    {
+        Insert = 1,
+        Update = 2,
+        Delete = 3
+    };
+    // newest change of one secret after a changelog position, see changesSince
+    struct secretChange
+    {
+        int64_t seq;
+        int secretId;
+        ChangeOp op;
+        int64_t changedAt; // unix seconds
+        bool deleted;      // tombstone, record is left empty
+        secretRecord record;
     };
     dataBase(const std::string &path);
+    // page-encrypted database file, see EncryptedVfs; the key is derived from
+    // passphrase and a salt kept in the file. Plaintext files are rejected.
+    dataBase(const std::string &path, const std::string &passphrase);
     ~dataBase();
     dataBase(const dataBase &) = delete;
     dataBase &operator=(const dataBase &) = delete;
 
-    bool addUser(const std::string &username, const std::vector<uint8_t> &hash, const std::vector<uint8_t> &salt);
+    // how long a call waits for another connection's write lock before it
+    // fails with SQLITE_BUSY; 0 (the default) fails right away
+    bool setBusyTimeout(int milliseconds);
+    // SQLite result code behind the last failed call, e.g. SQLITE_BUSY
+    int lastError() const;
+
+    bool addUser(const std::string &username, const std::vector<uint8_t> &hash, const std::vector<uint8_t> &salt,
+                 const std::vector<uint8_t> &wrappedKey = {}, const std::vector<uint8_t> &keyIv = {});
+    bool updateCredentials(int userId, const std::vector<uint8_t> &hash, const std::vector<uint8_t> &salt,
+                           const std::vector<uint8_t> &wrappedKey, const std::vector<uint8_t> &keyIv);
     bool PrintUser(const std::string &username); // just for testing .....
     bool getUser(const std::string &username, UserQuerey &uoutData);
-    bool addSecret(int userId, const std::string &title, const std::vector<uint8_t> &encryptedData, const std::vector<uint8_t> &iv);
+    bool addSecret(int userId, const std::string &title, const std::vector<uint8_t> &encryptedData, const std::vector<uint8_t> &iv,
+                   CipherSuite suite = CipherSuite::Aes256Gcm, uint8_t flags = 0);
     std::vector<secretRecord> getSecrets(int userId);
+    bool getSecret(int userId, const std::string &title, secretRecord &outRecord);
+    std::vector<secretRecord> getSecretsAfter(int userId, int afterId, int limit);
+    // the limit records with the largest ids <= upToId, newest first
+    std::vector<secretRecord> getSecretsUpTo(int userId, int upToId, int limit);
+    bool deleteSecret(int userId, int secretId);
+
+    // Delta sync. Triggers on secrets append every insert, update and delete
+    // to secrets_changelog under a monotonically increasing seq. Pass the
+    // largest seq seen so far (0 for a full sync); each changed secret is
+    // returned once, with its current contents or as a tombstone, in seq order.
+    std::vector<secretChange> changesSince(int userId, int64_t seq, int limit = 1000);
+    // drops changelog entries superseded by a newer one for the same secret;
+    // changesSince returns the same results afterwards
+    bool compactChangelog();
+
+    // Online backup through the SQLite backup API, read through a connection
+    // of its own. Each step copies options.pagesPerStep pages and then pauses
+    // for options.pauseMs. In WAL mode the copy is one snapshot and writers
+    // are never blocked; in rollback-journal mode writers wait at most one
+    // step, and a copy that keeps being restarted by commits finishes in one
+    // step. The copy is staged through the same VFS as this database
+    // (encrypted databases stay encrypted under their own passphrase) and
+    // renamed into place once complete; with options.passphrase it is sealed
+    // instead, see BackupStream.
+    bool backup(const std::string &destPath, const BackupOptions &options = {}, const BackupProgress &progress = {});
+    // the same backup handed to sink in chunks; the copy is staged in a
+    // private BackupStaging directory
+    bool backup(const BackupSink &sink, const BackupOptions &options = {}, const BackupProgress &progress = {});
+    // backup(destPath, options) now and then every interval on a thread owned
+    // by this object, until stopBackups() or destruction; false if already running
+    bool startBackups(const std::string &destPath, std::chrono::seconds interval, const BackupOptions &options = {});
+    // cancels a backup in progress and waits for the thread
+    void stopBackups();
+
+    bool beginRotation(int userId, const rotationState &state);
+    bool getRotation(int userId, rotationState &outState);
+    bool commitRotationBatch(int userId, const std::vector<secretRecord> &records, int lastSecretId);
+    bool finishRotation(int userId);
+    // drops the rotation row and keeps the current credentials
+    bool cancelRotation(int userId);
 
 private:
+    // timed wrappers, see Metrics
+    int prepare(const char *sql, sqlite3_stmt **stmt);
+    int step(sqlite3_stmt *stmt);
+    bool commit();
+    bool exec(const char *sql);
+    bool ensureColumn(const char *table, const char *column, const char *type);
+    void createTables();
+    bool copyPages(const std::string &destPath, const BackupOptions &options, const BackupProgress &progress);
+    std::unique_ptr<EncryptedVfs> m_vfs; // must outlive m_db
     sqlite3 *m_db;
+    std::jthread m_backups; // stopped before m_db is closed
 };
\ No newline at end of file
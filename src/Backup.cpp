@@ -0,0 +1,241 @@
+#include "Backup.hpp"
+#include "CryptoManager.hpp"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'R', 'Y', 'B', 'K', 'U', 'P', '1'};
+constexpr int kSaltBytes = 16;
+constexpr int kIvBytes = 12;
+constexpr int kTagBytes = 16;
+
+void chunkAad(uint8_t out[9], uint64_t index, bool last)
+{
+    for (int i = 0; i < 8; ++i) out[i] = static_cast<uint8_t>(index >> (56 - 8 * i));
+    out[8] = last ? 1 : 0;
+}
+
+// one GCM context for the whole stream, re-keyed with a fresh IV per chunk
+struct Cipher
+{
+    EVP_CIPHER_CTX *ctx;
+    std::vector<uint8_t> key;
+
+    explicit Cipher(std::vector<uint8_t> derived) : ctx(EVP_CIPHER_CTX_new()), key(std::move(derived))
+    {
+        if (!ctx) throw std::runtime_error("Failed to create cipher context");
+    }
+    ~Cipher()
+    {
+        EVP_CIPHER_CTX_free(ctx);
+        OPENSSL_cleanse(key.data(), key.size());
+    }
+    Cipher(const Cipher &) = delete;
+    Cipher &operator=(const Cipher &) = delete;
+};
+
+constexpr const char *kStagingPrefix = "cryptify-backup-";
+
+unsigned long currentProcess()
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<unsigned long>(getpid());
+#endif
+}
+
+bool processAlive(unsigned long pid)
+{
+#ifdef _WIN32
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+    if (!process) return GetLastError() == ERROR_ACCESS_DENIED;
+    DWORD code = 0;
+    bool alive = GetExitCodeProcess(process, &code) && code == STILL_ACTIVE;
+    CloseHandle(process);
+    return alive;
+#else
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+} // namespace
+
+BackupStaging::BackupStaging()
+{
+    const std::string prefix = (std::filesystem::temp_directory_path() /
+                                (kStagingPrefix + std::to_string(currentProcess()) + "-")).string();
+#ifdef _WIN32
+    // %TEMP% is already private to the user
+    auto random = CryptoManager::generateRandomBytes(8);
+    std::string name = prefix;
+    for (uint8_t byte : random) {
+        name += "0123456789abcdef"[byte >> 4];
+        name += "0123456789abcdef"[byte & 15];
+    }
+    if (!std::filesystem::create_directory(name)) {
+        throw std::runtime_error("Failed to create backup staging directory " + name);
+    }
+    m_directory = name;
+#else
+    // mkdtemp creates the directory 0700 in one step
+    std::string name = prefix + "XXXXXX";
+    if (!mkdtemp(name.data())) {
+        throw std::runtime_error("Failed to create backup staging directory " + name);
+    }
+    m_directory = name;
+#endif
+}
+
+BackupStaging::~BackupStaging()
+{
+    std::error_code error;
+    std::filesystem::remove_all(m_directory, error);
+}
+
+std::string BackupStaging::file(const std::string &name) const
+{
+    return (std::filesystem::path(m_directory) / name).string();
+}
+
+void BackupStaging::removeStale()
+{
+    std::error_code error;
+    std::filesystem::directory_iterator it(std::filesystem::temp_directory_path(error), error);
+    for (; !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+        const std::string name = it->path().filename().string();
+        if (name.rfind(kStagingPrefix, 0) != 0 || !it->is_directory(error)) continue;
+        const unsigned long pid = std::strtoul(name.c_str() + std::strlen(kStagingPrefix), nullptr, 10);
+        if (pid != 0 && pid != currentProcess() && !processAlive(pid)) {
+            std::error_code ignored;
+            std::filesystem::remove_all(it->path(), ignored);
+        }
+    }
+}
+
+bool BackupStream::write(const std::string &path, const std::string &passphrase, const BackupSink &sink)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::vector<uint8_t> plain(kChunkBytes);
+    if (passphrase.empty()) {
+        while (in.read(reinterpret_cast<char *>(plain.data()), plain.size()) || in.gcount() > 0) {
+            if (!sink(plain.data(), static_cast<size_t>(in.gcount()))) return false;
+        }
+        return in.eof();
+    }
+
+    auto salt = CryptoManager::generateRandomBytes(kSaltBytes);
+    Cipher cipher(CryptoManager::deriveKey(passphrase, salt));
+    std::vector<uint8_t> header(kMagic, kMagic + sizeof(kMagic));
+    header.insert(header.end(), salt.begin(), salt.end());
+    if (!sink(header.data(), header.size())) {
+        return false;
+    }
+
+    std::vector<uint8_t> chunk(4 + kIvBytes + kChunkBytes + kTagBytes);
+    bool ok = true;
+    for (uint64_t index = 0; ok; ++index) {
+        in.read(reinterpret_cast<char *>(plain.data()), plain.size());
+        const int length = static_cast<int>(in.gcount());
+        if (in.bad()) {
+            ok = false;
+            break;
+        }
+        const bool last = in.peek() == std::ifstream::traits_type::eof();
+        for (int i = 0; i < 4; ++i) chunk[i] = static_cast<uint8_t>(static_cast<uint32_t>(length) >> (24 - 8 * i));
+        auto iv = CryptoManager::generateRandomBytes(kIvBytes);
+        std::memcpy(chunk.data() + 4, iv.data(), kIvBytes);
+        uint8_t aad[9];
+        chunkAad(aad, index, last);
+        uint8_t *out = chunk.data() + 4 + kIvBytes;
+        int len = 0, finalLen = 0;
+        if (EVP_EncryptInit_ex(cipher.ctx, EVP_aes_256_gcm(), nullptr, cipher.key.data(), iv.data()) != 1 ||
+            EVP_EncryptUpdate(cipher.ctx, nullptr, &len, aad, sizeof(aad)) != 1 ||
+            EVP_EncryptUpdate(cipher.ctx, out, &len, plain.data(), length) != 1 ||
+            EVP_EncryptFinal_ex(cipher.ctx, out + len, &finalLen) != 1 ||
+            EVP_CIPHER_CTX_ctrl(cipher.ctx, EVP_CTRL_GCM_GET_TAG, kTagBytes, out + length) != 1) {
+            OPENSSL_cleanse(plain.data(), plain.size());
+            throw std::runtime_error("Failed to seal backup");
+        }
+        ok = sink(chunk.data(), 4 + kIvBytes + length + kTagBytes);
+        if (last) break;
+    }
+    OPENSSL_cleanse(plain.data(), plain.size());
+    return ok;
+}
+
+void BackupStream::unseal(const std::string &sealedPath, const std::string &passphrase, const std::string &destPath)
+{
+    std::ifstream in(sealedPath, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    std::vector<uint8_t> salt(kSaltBytes);
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+        !in.read(reinterpret_cast<char *>(salt.data()), salt.size())) {
+        throw std::runtime_error("Not a sealed backup: " + sealedPath);
+    }
+    Cipher cipher(CryptoManager::deriveKey(passphrase, salt));
+
+    const std::string partial = destPath + ".partial";
+    std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Failed to create " + partial);
+    }
+    auto fail = [&](const char *why) {
+        out.close();
+        std::filesystem::remove(partial);
+        throw std::runtime_error(why);
+    };
+
+    std::vector<uint8_t> chunk(kIvBytes + kChunkBytes + kTagBytes);
+    std::vector<uint8_t> plain(kChunkBytes);
+    for (uint64_t index = 0;; ++index) {
+        uint8_t lengthBytes[4];
+        if (!in.read(reinterpret_cast<char *>(lengthBytes), sizeof(lengthBytes))) {
+            fail("Sealed backup is truncated");
+        }
+        const uint32_t length = (uint32_t{lengthBytes[0]} << 24) | (uint32_t{lengthBytes[1]} << 16) |
+                                (uint32_t{lengthBytes[2]} << 8) | lengthBytes[3];
+        if (length > kChunkBytes || !in.read(reinterpret_cast<char *>(chunk.data()), kIvBytes + length + kTagBytes)) {
+            fail("Sealed backup is truncated");
+        }
+        const bool last = in.peek() == std::ifstream::traits_type::eof();
+        uint8_t aad[9];
+        chunkAad(aad, index, last);
+        const uint8_t *iv = chunk.data();
+        uint8_t *body = chunk.data() + kIvBytes;
+        int len = 0, finalLen = 0;
+        if (EVP_DecryptInit_ex(cipher.ctx, EVP_aes_256_gcm(), nullptr, cipher.key.data(), iv) != 1 ||
+            EVP_DecryptUpdate(cipher.ctx, nullptr, &len, aad, sizeof(aad)) != 1 ||
+            EVP_DecryptUpdate(cipher.ctx, plain.data(), &len, body, static_cast<int>(length)) != 1 ||
+            EVP_CIPHER_CTX_ctrl(cipher.ctx, EVP_CTRL_GCM_SET_TAG, kTagBytes, body + length) != 1 ||
+            EVP_DecryptFinal_ex(cipher.ctx, plain.data() + len, &finalLen) != 1) {
+            OPENSSL_cleanse(plain.data(), plain.size());
+            fail("Failed to open sealed backup: wrong passphrase or damaged file");
+        }
+        out.write(reinterpret_cast<const char *>(plain.data()), length);
+        if (last) break;
+    }
+    OPENSSL_cleanse(plain.data(), plain.size());
+    out.close();
+    if (!out) {
+        fail("Failed to write restored database");
+    }
+    std::filesystem::rename(partial, destPath);
+}
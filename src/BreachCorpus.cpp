@@ -0,0 +1,337 @@
+#include "BreachCorpus.hpp"
+#include "Compression.hpp"
+#include "CryptoManager.hpp"
+#include <openssl/crypto.h>
+#include <openssl/sha.h>
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static_assert(std::endian::native == std::endian::little, "corpus format is little-endian");
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'R', 'Y', 'B', 'R', 'C', 'H', '1'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kBuckets = 65536;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint8_t kind;
+    uint8_t digestSize;
+    uint16_t reserved0;
+    uint64_t count;
+    uint64_t reserved1;
+};
+static_assert(sizeof(Header) == 32);
+constexpr size_t kIndexSize = (kBuckets + 1) * sizeof(uint64_t);
+
+size_t digestSizeOf(BreachCorpus::HashKind kind)
+{
+    switch (kind) {
+    case BreachCorpus::HashKind::Sha1: return SHA_DIGEST_LENGTH;
+    case BreachCorpus::HashKind::Ntlm: return 16;
+    }
+    throw std::runtime_error("Unknown breach corpus hash kind");
+}
+
+template <typename T>
+T load(const uint8_t *at)
+{
+    T value;
+    std::memcpy(&value, at, sizeof(T));
+    return value;
+}
+
+// bytes 2..9 of a digest as a number, for interpolating inside a bucket
+uint64_t probeKey(const uint8_t *digest)
+{
+    uint64_t key = 0;
+    for (int i = 2; i < 10; ++i) key = (key << 8) | digest[i];
+    return key;
+}
+
+// RFC 1320. Only NTLM needs MD4, and OpenSSL 3 hides it in the legacy provider.
+std::array<uint8_t, 16> md4(const std::vector<uint8_t> &message)
+{
+    uint32_t a0 = 0x67452301, b0 = 0xefcdab89, c0 = 0x98badcfe, d0 = 0x10325476;
+    std::vector<uint8_t> data(message);
+    const uint64_t bits = static_cast<uint64_t>(message.size()) * 8;
+    data.push_back(0x80);
+    while (data.size() % 64 != 56) data.push_back(0);
+    for (int i = 0; i < 8; ++i) data.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+
+    auto f = [](uint32_t x, uint32_t y, uint32_t z) { return (x & y) | (~x & z); };
+    auto g = [](uint32_t x, uint32_t y, uint32_t z) { return (x & y) | (x & z) | (y & z); };
+    auto h = [](uint32_t x, uint32_t y, uint32_t z) { return x ^ y ^ z; };
+    static constexpr int r1[4] = {3, 7, 11, 19}, r2[4] = {3, 5, 9, 13}, r3[4] = {3, 9, 11, 15};
+    static constexpr int order3[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+
+    for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t x[16];
+        for (int i = 0; i < 16; ++i) x[i] = load<uint32_t>(&data[block + 4 * i]);
+        uint32_t s[4] = {a0, b0, c0, d0};
+        // s rotates through a, d, c, b; step i updates s[(4 - i % 4) % 4]
+        for (int i = 0; i < 16; ++i) {
+            uint32_t &t = s[(4 - i % 4) % 4];
+            t = std::rotl(t + f(s[(5 - i % 4) % 4], s[(6 - i % 4) % 4], s[(7 - i % 4) % 4]) + x[i], r1[i % 4]);
+        }
+        for (int i = 0; i < 16; ++i) {
+            uint32_t &t = s[(4 - i % 4) % 4];
+            int k = (i % 4) * 4 + i / 4;
+            t = std::rotl(t + g(s[(5 - i % 4) % 4], s[(6 - i % 4) % 4], s[(7 - i % 4) % 4]) + x[k] + 0x5a827999u, r2[i % 4]);
+        }
+        for (int i = 0; i < 16; ++i) {
+            uint32_t &t = s[(4 - i % 4) % 4];
+            t = std::rotl(t + h(s[(5 - i % 4) % 4], s[(6 - i % 4) % 4], s[(7 - i % 4) % 4]) + x[order3[i]] + 0x6ed9eba1u, r3[i % 4]);
+        }
+        a0 += s[0];
+        b0 += s[1];
+        c0 += s[2];
+        d0 += s[3];
+    }
+    OPENSSL_cleanse(data.data(), data.size());
+    std::array<uint8_t, 16> out;
+    for (int i = 0; i < 4; ++i) {
+        uint32_t word = i == 0 ? a0 : i == 1 ? b0 : i == 2 ? c0 : d0;
+        std::memcpy(&out[4 * i], &word, 4);
+    }
+    return out;
+}
+
+// UTF-8 to UTF-16LE bytes; malformed input becomes U+FFFD like Windows does
+std::vector<uint8_t> utf16le(std::string_view text)
+{
+    std::vector<uint8_t> out;
+    auto put = [&](uint32_t unit) {
+        out.push_back(static_cast<uint8_t>(unit));
+        out.push_back(static_cast<uint8_t>(unit >> 8));
+    };
+    for (size_t i = 0; i < text.size();) {
+        uint8_t lead = static_cast<uint8_t>(text[i]);
+        int extra = lead < 0x80 ? 0 : (lead >> 5) == 0x6 ? 1 : (lead >> 4) == 0xe ? 2 : (lead >> 3) == 0x1e ? 3 : -1;
+        uint32_t cp = extra == 0 ? lead : extra == 1 ? lead & 0x1f : extra == 2 ? lead & 0x0f : lead & 0x07;
+        bool valid = extra >= 0 && i + extra < text.size();
+        for (int k = 1; valid && k <= extra; ++k) {
+            uint8_t next = static_cast<uint8_t>(text[i + k]);
+            valid = (next & 0xc0) == 0x80;
+            cp = (cp << 6) | (next & 0x3f);
+        }
+        if (!valid || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+            put(0xfffd);
+            ++i;
+            continue;
+        }
+        i += extra + 1;
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            put(0xd800 | (cp >> 10));
+            put(0xdc00 | (cp & 0x3ff));
+        } else {
+            put(cp);
+        }
+    }
+    return out;
+}
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+} // namespace
+
+BreachCorpus::BreachCorpus(const std::string &path) : m_file(path)
+{
+    auto bytes = m_file.bytes();
+    if (bytes.size() < sizeof(Header) + kIndexSize) {
+        throw std::runtime_error("Breach corpus is truncated: " + path);
+    }
+    Header header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+        throw std::runtime_error("Not a breach corpus: " + path);
+    }
+    m_kind = static_cast<HashKind>(header.kind);
+    m_digestSize = digestSizeOf(m_kind);
+    if (header.digestSize != m_digestSize) {
+        throw std::runtime_error("Breach corpus has a bad digest size: " + path);
+    }
+    m_entrySize = m_digestSize + sizeof(uint32_t);
+    m_count = header.count;
+    if ((bytes.size() - sizeof(Header) - kIndexSize) / m_entrySize != m_count ||
+        (bytes.size() - sizeof(Header) - kIndexSize) % m_entrySize != 0) {
+        throw std::runtime_error("Breach corpus size does not match its header: " + path);
+    }
+    m_index = bytes.data() + sizeof(Header);
+    m_entries = m_index + kIndexSize;
+    // lookups trust the index, so check it once
+    uint64_t previous = 0;
+    for (size_t bucket = 0; bucket <= kBuckets; ++bucket) {
+        uint64_t start = load<uint64_t>(m_index + bucket * sizeof(uint64_t));
+        if (start < previous || start > m_count) {
+            throw std::runtime_error("Breach corpus index is corrupted: " + path);
+        }
+        previous = start;
+    }
+    if (previous != m_count) {
+        throw std::runtime_error("Breach corpus index is corrupted: " + path);
+    }
+    m_file.adviseRandom();
+}
+
+std::vector<uint8_t> BreachCorpus::digest(std::string_view password, HashKind kind)
+{
+    if (kind == HashKind::Ntlm) {
+        auto unicode = utf16le(password);
+        auto hash = md4(unicode);
+        OPENSSL_cleanse(unicode.data(), unicode.size());
+        return {hash.begin(), hash.end()};
+    }
+    std::vector<uint8_t> hash(SHA_DIGEST_LENGTH);
+    SHA1(reinterpret_cast<const unsigned char *>(password.data()), password.size(), hash.data());
+    return hash;
+}
+
+uint32_t BreachCorpus::occurrences(std::string_view password) const
+{
+    auto hash = digest(password, m_kind);
+    return occurrences(hash);
+}
+
+uint32_t BreachCorpus::occurrences(std::span<const uint8_t> digest) const
+{
+    if (digest.size() != m_digestSize) {
+        return 0;
+    }
+    const size_t bucket = (static_cast<size_t>(digest[0]) << 8) | digest[1];
+    size_t lo = load<uint64_t>(m_index + bucket * sizeof(uint64_t));
+    size_t hi = load<uint64_t>(m_index + (bucket + 1) * sizeof(uint64_t));
+    auto entry = [&](size_t i) { return m_entries + i * m_entrySize; };
+    auto compare = [&](size_t i) { return std::memcmp(entry(i), digest.data(), m_digestSize); };
+
+    // digests are uniform, so a few interpolation steps land next to the
+    // entry; binary search finishes (and bounds the worst case)
+    const uint64_t target = probeKey(digest.data());
+    for (int step = 0; step < 4 && hi - lo > 8; ++step) {
+        const uint64_t first = probeKey(entry(lo));
+        const uint64_t last = probeKey(entry(hi - 1));
+        if (target < first || target > last) {
+            return 0;
+        }
+        const double fraction = last == first ? 0.0 : static_cast<double>(target - first) / static_cast<double>(last - first);
+        size_t guess = lo + static_cast<size_t>(fraction * static_cast<double>(hi - 1 - lo));
+        int order = compare(guess);
+        if (order == 0) {
+            return load<uint32_t>(entry(guess) + m_digestSize);
+        }
+        if (order < 0) lo = guess + 1;
+        else hi = guess;
+    }
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int order = compare(mid);
+        if (order == 0) {
+            return load<uint32_t>(entry(mid) + m_digestSize);
+        }
+        if (order < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return 0;
+}
+
+std::vector<BreachCorpus::Finding> BreachCorpus::checkVault(dataBase &db, int userId, const std::vector<uint8_t> &vaultKey) const
+{
+    std::vector<Finding> findings;
+    for (const auto &record : db.getSecrets(userId)) {
+        auto plaintext = CryptoManager::decrypt(record.suite, record.encryptedData, vaultKey, record.iv);
+        Compression::unpack(plaintext, record.flags);
+        auto hash = digest({reinterpret_cast<const char *>(plaintext.data()), plaintext.size()}, m_kind);
+        OPENSSL_cleanse(plaintext.data(), plaintext.size());
+        if (uint32_t count = occurrences(hash)) {
+            findings.push_back({record.id, record.title, count});
+        }
+    }
+    return findings;
+}
+
+size_t BreachCorpus::build(const std::string &textPath, const std::string &outPath, HashKind kind)
+{
+    const size_t digestSize = digestSizeOf(kind);
+    std::ifstream in(textPath);
+    if (!in) {
+        throw std::runtime_error("Cannot open breach list: " + textPath);
+    }
+    const std::string tempPath = outPath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot write breach corpus: " + tempPath);
+    }
+    // header and index are rewritten once the entries are known
+    std::vector<char> placeholder(sizeof(Header) + kIndexSize, 0);
+    out.write(placeholder.data(), placeholder.size());
+
+    std::vector<uint64_t> perBucket(kBuckets, 0);
+    std::vector<uint8_t> entry(digestSize + sizeof(uint32_t));
+    std::vector<uint8_t> previous;
+    uint64_t count = 0;
+    size_t lineNumber = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        bool valid = line.size() > digestSize * 2 && line[digestSize * 2] == ':';
+        for (size_t i = 0; valid && i < digestSize; ++i) {
+            int high = hexValue(line[2 * i]), low = hexValue(line[2 * i + 1]);
+            valid = high >= 0 && low >= 0;
+            entry[i] = static_cast<uint8_t>((high << 4) | low);
+        }
+        if (!valid) {
+            std::remove(tempPath.c_str());
+            throw std::runtime_error("Malformed breach list line " + std::to_string(lineNumber));
+        }
+        if (!previous.empty() && std::memcmp(previous.data(), entry.data(), digestSize) >= 0) {
+            std::remove(tempPath.c_str());
+            throw std::runtime_error("Breach list must be sorted by hash without duplicates (line " +
+                                     std::to_string(lineNumber) + ")");
+        }
+        unsigned long long prevalence = std::strtoull(line.c_str() + digestSize * 2 + 1, nullptr, 10);
+        uint32_t stored = prevalence > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(prevalence);
+        // a hash listed with count 0 would read as "not found"
+        if (stored == 0) stored = 1;
+        std::memcpy(entry.data() + digestSize, &stored, sizeof(stored));
+        out.write(reinterpret_cast<const char *>(entry.data()), entry.size());
+        ++perBucket[(static_cast<size_t>(entry[0]) << 8) | entry[1]];
+        previous.assign(entry.begin(), entry.begin() + digestSize);
+        ++count;
+    }
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.kind = static_cast<uint8_t>(kind);
+    header.digestSize = static_cast<uint8_t>(digestSize);
+    header.count = count;
+    std::vector<uint64_t> index(kBuckets + 1, 0);
+    for (size_t bucket = 0; bucket < kBuckets; ++bucket) {
+        index[bucket + 1] = index[bucket] + perBucket[bucket];
+    }
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(index.data()), kIndexSize);
+    out.close();
+    if (!out || std::rename(tempPath.c_str(), outPath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        throw std::runtime_error("Failed to write breach corpus: " + outPath);
+    }
+    return count;
+}
@@ -0,0 +1,63 @@
+#include "Compression.hpp"
+#include <openssl/crypto.h>
+#include <stdexcept>
+#ifdef CRYPTIFY_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+// refuse frames claiming more than this, records are never that large
+constexpr unsigned long long kMaxRecordSize = 1ull << 30;
+}
+
+bool Compression::available(){
+#ifdef CRYPTIFY_HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint8_t Compression::pack(std::string &plaintext, size_t threshold, int level){
+#ifdef CRYPTIFY_HAVE_ZSTD
+    if (plaintext.size() < threshold) {
+        return 0;
+    }
+    std::string compressed(ZSTD_compressBound(plaintext.size()), '\0');
+    size_t size = ZSTD_compress(compressed.data(), compressed.size(), plaintext.data(), plaintext.size(), level);
+    if (ZSTD_isError(size) || size >= plaintext.size()) {
+        return 0;
+    }
+    compressed.resize(size);
+    plaintext.swap(compressed);
+    // the uncompressed copy held secret data
+    OPENSSL_cleanse(compressed.data(), compressed.size());
+    return RecordCompressed;
+#else
+    (void)plaintext;
+    (void)threshold;
+    (void)level;
+    return 0;
+#endif
+}
+
+void Compression::unpack(std::vector<uint8_t> &plaintext, uint8_t flags){
+    if (!(flags & RecordCompressed)) {
+        return;
+    }
+#ifdef CRYPTIFY_HAVE_ZSTD
+    unsigned long long size = ZSTD_getFrameContentSize(plaintext.data(), plaintext.size());
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN || size > kMaxRecordSize) {
+        throw std::runtime_error("Invalid compressed record");
+    }
+    std::vector<uint8_t> output(size);
+    size_t written = ZSTD_decompress(output.data(), output.size(), plaintext.data(), plaintext.size());
+    if (ZSTD_isError(written) || written != size) {
+        throw std::runtime_error("Failed to decompress record");
+    }
+    OPENSSL_cleanse(plaintext.data(), plaintext.size());
+    plaintext.swap(output);
+#else
+    throw std::runtime_error("Record is compressed but this build has no zstd support");
+#endif
+}
@@ -3,7 +3,18 @@
 #include <openssl/evp.h>
 #include <openssl/sha.h>
 #include <openssl/aes.h> 
+#include <openssl/crypto.h>
+#include "Metrics.hpp"
+#include "MultiPbkdf2.hpp"
 #include <stdexcept>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
 
 
 //implemented 
@@ -40,9 +51,14 @@ std::vector<uint8_t> CryptoManager::hashPassword(const std::string &password, co
     return hash;
 };
 
+namespace {
+// shared by deriveKey and deriveKeys, which must stay interchangeable
+const int ITERATIONS = 100000;
+const int KEY_LENGTH = 32;
+}
+
 std::vector<uint8_t> CryptoManager::deriveKey(const std::string &pass, const std::vector<uint8_t> &salt){
-    const int ITERATIONS = 100000;
-    const int KEY_LENGTH = 32; 
+    ScopedTimer timer(MetricOp::Kdf);
     std::vector<uint8_t> key(KEY_LENGTH);
 // PKCS5_PBKDF2_HMAC is the OpenSSL function for this
     int result = PKCS5_PBKDF2_HMAC(
@@ -60,15 +76,22 @@ std::vector<uint8_t> CryptoManager::deriveKey(const std::string &pass, const std
     return key;
 }
 
+std::vector<std::vector<uint8_t>> CryptoManager::deriveKeys(const std::vector<std::string> &passes,
+                                                            const std::vector<std::vector<uint8_t>> &salts){
+    ScopedTimer timer(MetricOp::Kdf);
+    return MultiPbkdf2::derive(passes, salts, ITERATIONS, KEY_LENGTH);
+}
 
-std::vector<uint8_t> CryptoManager::encrypt(const std::string& plaintext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
-    
+
+template <typename Suite>
+std::vector<uint8_t> CryptoManager::encrypt(std::string_view plaintext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+    ScopedTimer timer(MetricOp::Encrypt);
     // 1. Context Setup
     EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
     if (!ctx) throw std::runtime_error("Failed to create cipher context");
 
-    // 2. Init Encryption (AES-256-GCM)
-    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) != 1) {
+    // 2. Init Encryption (AES-256-GCM or ChaCha20-Poly1305, see CipherSuite.hpp)
+    if (EVP_EncryptInit_ex(ctx, Suite::cipher(), nullptr, nullptr, nullptr) != 1) {
         EVP_CIPHER_CTX_free(ctx); 
         throw std::runtime_error("Encrypt init warning");
     }
@@ -85,7 +108,7 @@ std::vector<uint8_t> CryptoManager::encrypt(const std::string& plaintext, const
     int ciphertext_len;
 
     if (EVP_EncryptUpdate(ctx, ciphertext.data(), &len, 
-                          reinterpret_cast<const unsigned char*>(plaintext.c_str()), plaintext.size()) != 1) {
+                          reinterpret_cast<const unsigned char*>(plaintext.data()), plaintext.size()) != 1) {
         EVP_CIPHER_CTX_free(ctx);
         throw std::runtime_error("Encrypt update failed");
     }
@@ -98,12 +121,12 @@ std::vector<uint8_t> CryptoManager::encrypt(const std::string& plaintext, const
     }
     ciphertext_len += len;
 
-    // 6. Get the Tag (Critical for GCM!)
-    // The tag is usually 16 bytes. We verify this during decryption.
+    // 6. Get the Tag (Critical for AEAD!)
+    // The tag is 16 bytes for both suites. We verify this during decryption.
     std::vector<uint8_t> tag(16);
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, tag.data()) != 1) {
+    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, 16, tag.data()) != 1) {
         EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Failed to get GCM tag");
+        throw std::runtime_error("Failed to get AEAD tag");
     }
 
     // 7. Cleaning up
@@ -117,8 +140,9 @@ std::vector<uint8_t> CryptoManager::encrypt(const std::string& plaintext, const
     return ciphertext;
 }
 
+template <typename Suite>
 std::vector<uint8_t> CryptoManager::decrypt(const std::vector<uint8_t>& ciphertext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
-    
+    ScopedTimer timer(MetricOp::Decrypt);
     // 1. Validation
     if (ciphertext.size() < 16) {
         throw std::runtime_error("Ciphertext too short (no tag)");
@@ -134,7 +158,7 @@ std::vector<uint8_t> CryptoManager::decrypt(const std::vector<uint8_t>& cipherte
     if (!ctx) throw std::runtime_error("Failed to create cipher context");
 
     // 4. Init Decryption
-    if (EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) != 1) {
+    if (EVP_DecryptInit_ex(ctx, Suite::cipher(), nullptr, nullptr, nullptr) != 1) {
         EVP_CIPHER_CTX_free(ctx); 
         throw std::runtime_error("Decrypt init warning");
     }
@@ -159,7 +183,7 @@ std::vector<uint8_t> CryptoManager::decrypt(const std::vector<uint8_t>& cipherte
     plaintext_len = len;
 
     // 7. SET THE TAG (Critical for Verification)
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, 16, tag.data()) != 1) {
+    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, 16, tag.data()) != 1) {
         EVP_CIPHER_CTX_free(ctx);
         throw std::runtime_error("Failed to set expected tag");
     }
@@ -178,3 +202,97 @@ std::vector<uint8_t> CryptoManager::decrypt(const std::vector<uint8_t>& cipherte
         throw std::runtime_error("Decryption Verification Failed! Wrong Key or Corrupted Data.");
     }
 }
+
+template std::vector<uint8_t> CryptoManager::encrypt<Aes256GcmSuite>(std::string_view, const std::vector<uint8_t>&, const std::vector<uint8_t>&);
+template std::vector<uint8_t> CryptoManager::encrypt<ChaCha20Poly1305Suite>(std::string_view, const std::vector<uint8_t>&, const std::vector<uint8_t>&);
+template std::vector<uint8_t> CryptoManager::decrypt<Aes256GcmSuite>(const std::vector<uint8_t>&, const std::vector<uint8_t>&, const std::vector<uint8_t>&);
+template std::vector<uint8_t> CryptoManager::decrypt<ChaCha20Poly1305Suite>(const std::vector<uint8_t>&, const std::vector<uint8_t>&, const std::vector<uint8_t>&);
+
+std::vector<uint8_t> CryptoManager::encrypt(const std::string& plaintext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+    return encrypt<Aes256GcmSuite>(plaintext, key, iv);
+}
+
+std::vector<uint8_t> CryptoManager::decrypt(const std::vector<uint8_t>& ciphertext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+    return decrypt<Aes256GcmSuite>(ciphertext, key, iv);
+}
+
+std::vector<uint8_t> CryptoManager::encrypt(CipherSuite suite, const std::string& plaintext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+    switch (suite) {
+    case CipherSuite::Aes256Gcm: return encrypt<Aes256GcmSuite>(plaintext, key, iv);
+    case CipherSuite::ChaCha20Poly1305: return encrypt<ChaCha20Poly1305Suite>(plaintext, key, iv);
+    }
+    throw std::runtime_error("Unknown cipher suite");
+}
+
+std::vector<uint8_t> CryptoManager::encrypt(CipherSuite suite, const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+    std::string_view bytes(reinterpret_cast<const char*>(plaintext.data()), plaintext.size());
+    switch (suite) {
+    case CipherSuite::Aes256Gcm: return encrypt<Aes256GcmSuite>(bytes, key, iv);
+    case CipherSuite::ChaCha20Poly1305: return encrypt<ChaCha20Poly1305Suite>(bytes, key, iv);
+    }
+    throw std::runtime_error("Unknown cipher suite");
+}
+
+std::vector<uint8_t> CryptoManager::decrypt(CipherSuite suite, const std::vector<uint8_t>& ciphertext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+    switch (suite) {
+    case CipherSuite::Aes256Gcm: return decrypt<Aes256GcmSuite>(ciphertext, key, iv);
+    case CipherSuite::ChaCha20Poly1305: return decrypt<ChaCha20Poly1305Suite>(ciphertext, key, iv);
+    }
+    throw std::runtime_error("Unknown cipher suite");
+}
+
+bool CryptoManager::hasAesHardware() {
+    static const bool detected = [] {
+#if defined(__x86_64__) || defined(__i386__)
+        // CPUID.1:ECX bit 25 = AES-NI, bit 1 = PCLMULQDQ (needed for fast GHASH)
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return (ecx & (1u << 25)) && (ecx & (1u << 1));
+#elif defined(_M_X64) || defined(_M_IX86)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 25)) && (info[2] & (1 << 1));
+#elif defined(__aarch64__) && defined(__linux__)
+        return (getauxval(AT_HWCAP) & HWCAP_AES) && (getauxval(AT_HWCAP) & HWCAP_PMULL);
+#elif defined(__aarch64__) && defined(__APPLE__)
+        return true; // every Apple arm64 core has the crypto extensions
+#else
+        return false;
+#endif
+    }();
+    return detected;
+}
+
+// AES-GCM is the fastest AEAD with hardware support, ChaCha20-Poly1305 is
+// several times faster than table-based AES without it
+CipherSuite CryptoManager::preferredSuite() {
+    return hasAesHardware() ? CipherSuite::Aes256Gcm : CipherSuite::ChaCha20Poly1305;
+}
+
+std::vector<uint8_t> CryptoManager::wrapKey(const std::vector<uint8_t>& vaultKey, const std::vector<uint8_t>& kek, const std::vector<uint8_t>& iv) {
+    std::string keyBytes(vaultKey.begin(), vaultKey.end());
+    auto wrapped = encrypt(keyBytes, kek, iv);
+    OPENSSL_cleanse(keyBytes.data(), keyBytes.size());
+    return wrapped;
+}
+
+std::vector<uint8_t> CryptoManager::unwrapKey(const std::vector<uint8_t>& wrappedKey, const std::vector<uint8_t>& kek, const std::vector<uint8_t>& iv) {
+    auto vaultKey = decrypt(wrappedKey, kek, iv);
+    if (vaultKey.size() != 32) {
+        throw std::runtime_error("Unwrapped vault key has wrong length");
+    }
+    return vaultKey;
+}
+
+std::vector<uint8_t> CryptoManager::openVaultKey(const std::string& pass, const std::vector<uint8_t>& salt,
+                                                 const std::vector<uint8_t>& wrappedKey, const std::vector<uint8_t>& keyIv) {
+    auto kek = deriveKey(pass, salt);
+    if (wrappedKey.empty()) {
+        return kek;
+    }
+    auto vaultKey = unwrapKey(wrappedKey, kek, keyIv);
+    OPENSSL_cleanse(kek.data(), kek.size());
+    return vaultKey;
+}
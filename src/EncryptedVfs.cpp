@@ -0,0 +1,425 @@
+#include "EncryptedVfs.hpp"
+#include <sqlite3.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef SQLITE_IOERR_DATA
+#define SQLITE_IOERR_DATA (SQLITE_IOERR | (32 << 8))
+#endif
+
+namespace {
+
+constexpr int kIvBytes = 12;
+constexpr int kTagBytes = 16;
+constexpr int kHeaderBytes = 100;   // plaintext SQLite header at the start of page 1
+constexpr int kSaltOffset = kIvBytes + kTagBytes; // inside the page 1 reserve
+constexpr int kWalHeaderBytes = 32;
+constexpr int kWalFrameHeaderBytes = 24;
+
+enum class FileKind : uint8_t { Plain = 0, Main = 1, Journal = 2, Wal = 3 };
+
+struct EncFile;
+const sqlite3_io_methods *encMethods();
+
+bool isPageSize(int n){
+    return n >= 512 && n <= 65536 && (n & (n - 1)) == 0;
+}
+
+// page size field of a plaintext SQLite header, 0 if it is not one
+int headerPageSize(const uint8_t *header){
+    if (std::memcmp(header, "SQLite format 3", 16) != 0) return 0;
+    int pageSize = (header[16] << 8) | header[17];
+    if (pageSize == 1) pageSize = 65536;
+    return isPageSize(pageSize) ? pageSize : 0;
+}
+
+} // namespace
+
+struct EncryptedVfs::State
+{
+    sqlite3_vfs vfs;
+    sqlite3_vfs *root;
+    std::string name;
+    uint8_t key[32];
+    uint8_t salt[kSaltBytes];
+    // read from the header when the main db is opened (journal and WAL
+    // recovery need it before any page is read), else from the first write
+    std::atomic<int> pageSize{0};
+};
+
+namespace {
+
+// SQLite allocates vfs.szOsFile bytes per open file; the wrapped file of the
+// root VFS lives right behind this struct.
+struct EncFile
+{
+    sqlite3_file base;
+    EncryptedVfs::State *state;
+    FileKind kind;
+    EVP_CIPHER_CTX *ctx;
+    uint8_t *scratch;
+    int scratchSize;
+    sqlite3_file *real() { return reinterpret_cast<sqlite3_file *>(this + 1); }
+};
+
+uint8_t *scratchFor(EncFile *f, int size){
+    if (f->scratchSize < size) {
+        std::free(f->scratch);
+        f->scratch = static_cast<uint8_t *>(std::malloc(size));
+        f->scratchSize = f->scratch ? size : 0;
+    }
+    return f->scratch;
+}
+
+// AAD binds a page image to the kind of file and its position, so pages
+// cannot be swapped around or replayed from the journal into the db
+void pageAad(uint8_t out[9], FileKind kind, int64_t index){
+    out[0] = static_cast<uint8_t>(kind);
+    for (int i = 0; i < 8; ++i) out[1 + i] = static_cast<uint8_t>(index >> (56 - 8 * i));
+}
+
+// encrypts in[start, P-R) into out and fills the reserve; out[0, start) is copied
+bool sealPage(EncFile *f, const uint8_t *in, uint8_t *out, int pageSize, int start, int64_t index){
+    const int body = pageSize - EncryptedVfs::kReserveBytes;
+    uint8_t *reserve = out + body;
+    std::memcpy(out, in, start);
+    std::memset(reserve, 0, EncryptedVfs::kReserveBytes);
+    if (RAND_bytes(reserve, kIvBytes) != 1) return false;
+
+    uint8_t aad[9];
+    pageAad(aad, f->kind, index);
+    int len = 0;
+    if (EVP_EncryptInit_ex(f->ctx, nullptr, nullptr, f->state->key, reserve) != 1 ||
+        EVP_EncryptUpdate(f->ctx, nullptr, &len, aad, sizeof(aad)) != 1 ||
+        (start > 0 && EVP_EncryptUpdate(f->ctx, nullptr, &len, in, start) != 1) ||
+        EVP_EncryptUpdate(f->ctx, out + start, &len, in + start, body - start) != 1 ||
+        EVP_EncryptFinal_ex(f->ctx, out + start + len, &len) != 1 ||
+        EVP_CIPHER_CTX_ctrl(f->ctx, EVP_CTRL_AEAD_GET_TAG, kTagBytes, reserve + kIvBytes) != 1) {
+        return false;
+    }
+    if (start == kHeaderBytes) {
+        std::memcpy(reserve + kSaltOffset, f->state->salt, EncryptedVfs::kSaltBytes);
+    }
+    return true;
+}
+
+// decrypts a page in place; the reserve is zeroed afterwards so SQLite never
+// sees (or checksums) the per-write IV and tag
+bool openPage(EncFile *f, uint8_t *page, int pageSize, int start, int64_t index){
+    const int body = pageSize - EncryptedVfs::kReserveBytes;
+    uint8_t *reserve = page + body;
+    uint8_t aad[9];
+    pageAad(aad, f->kind, index);
+    int len = 0;
+    if (EVP_DecryptInit_ex(f->ctx, nullptr, nullptr, f->state->key, reserve) != 1 ||
+        EVP_DecryptUpdate(f->ctx, nullptr, &len, aad, sizeof(aad)) != 1 ||
+        (start > 0 && EVP_DecryptUpdate(f->ctx, nullptr, &len, page, start) != 1) ||
+        EVP_DecryptUpdate(f->ctx, page + start, &len, page + start, body - start) != 1 ||
+        EVP_CIPHER_CTX_ctrl(f->ctx, EVP_CTRL_AEAD_SET_TAG, kTagBytes, reserve + kIvBytes) != 1 ||
+        EVP_DecryptFinal_ex(f->ctx, page + start + len, &len) != 1) {
+        OPENSSL_cleanse(page + start, body - start);
+        return false;
+    }
+    std::memset(reserve, 0, EncryptedVfs::kReserveBytes);
+    return true;
+}
+
+// Where the page image inside an access starts, or -1 for accesses that are
+// not page images (headers, journal records, WAL frame headers).
+int pageImageOffset(EncFile *f, int iAmt, sqlite3_int64 iOfst){
+    int pageSize = f->state->pageSize.load(std::memory_order_relaxed);
+    switch (f->kind) {
+    case FileKind::Main:
+        if (isPageSize(iAmt) && iOfst % iAmt == 0) {
+            if (pageSize != iAmt) f->state->pageSize.store(iAmt, std::memory_order_relaxed);
+            return 0;
+        }
+        return -1;
+    case FileKind::Journal:
+        // journal records are <pgno:4><page><checksum:4>, starting at sector boundaries
+        return (pageSize && iAmt == pageSize && iOfst % 8 == 4) ? 0 : -1;
+    case FileKind::Wal: {
+        if (!pageSize || iOfst < kWalHeaderBytes) return -1;
+        const sqlite3_int64 frame = pageSize + kWalFrameHeaderBytes;
+        const sqlite3_int64 at = (iOfst - kWalHeaderBytes) % frame;
+        if (iAmt == pageSize && at == kWalFrameHeaderBytes) return 0;
+        if (iAmt == frame && at == 0) return kWalFrameHeaderBytes;
+        return -1;
+    }
+    default:
+        return -1;
+    }
+}
+
+int encClose(sqlite3_file *file){
+    EncFile *f = reinterpret_cast<EncFile *>(file);
+    int rc = f->real()->pMethods ? f->real()->pMethods->xClose(f->real()) : SQLITE_OK;
+    EVP_CIPHER_CTX_free(f->ctx);
+    if (f->scratch) OPENSSL_cleanse(f->scratch, f->scratchSize);
+    std::free(f->scratch);
+    f->ctx = nullptr;
+    f->scratch = nullptr;
+    return rc;
+}
+
+int encRead(sqlite3_file *file, void *buf, int iAmt, sqlite3_int64 iOfst){
+    EncFile *f = reinterpret_cast<EncFile *>(file);
+    int rc = f->real()->pMethods->xRead(f->real(), buf, iAmt, iOfst);
+    int at = pageImageOffset(f, iAmt, iOfst);
+    if (rc != SQLITE_OK || at < 0) return rc; // short reads come back zero-filled
+    uint8_t *page = static_cast<uint8_t *>(buf) + at;
+    const int pageSize = iAmt - at;
+    const bool first = f->kind == FileKind::Main && iOfst == 0;
+    const int64_t index = f->kind == FileKind::Main ? iOfst / pageSize + 1 : iOfst + at;
+    return openPage(f, page, pageSize, first ? kHeaderBytes : 0, index) ? SQLITE_OK : SQLITE_IOERR_DATA;
+}
+
+int encWrite(sqlite3_file *file, const void *buf, int iAmt, sqlite3_int64 iOfst){
+    EncFile *f = reinterpret_cast<EncFile *>(file);
+    int at = pageImageOffset(f, iAmt, iOfst);
+    if (at < 0) {
+        // everything SQLite writes to the main db is a whole page
+        if (f->kind == FileKind::Main) return SQLITE_IOERR_WRITE;
+        return f->real()->pMethods->xWrite(f->real(), buf, iAmt, iOfst);
+    }
+    const uint8_t *in = static_cast<const uint8_t *>(buf);
+    const int pageSize = iAmt - at;
+    const bool first = f->kind == FileKind::Main && iOfst == 0;
+    // page 1 carries the reserve size; refuse to write pages with no room for the tag
+    if (first && in[20] < EncryptedVfs::kReserveBytes) return SQLITE_IOERR_WRITE;
+    uint8_t *out = scratchFor(f, iAmt);
+    if (!out) return SQLITE_IOERR_NOMEM;
+    std::memcpy(out, in, at);
+    const int64_t index = f->kind == FileKind::Main ? iOfst / pageSize + 1 : iOfst + at;
+    if (!sealPage(f, in + at, out + at, pageSize, first ? kHeaderBytes : 0, index)) return SQLITE_IOERR_WRITE;
+    return f->real()->pMethods->xWrite(f->real(), out, iAmt, iOfst);
+}
+
+int encTruncate(sqlite3_file *file, sqlite3_int64 size){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->xTruncate(r, size);
+}
+int encSync(sqlite3_file *file, int flags){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->xSync(r, flags);
+}
+int encFileSize(sqlite3_file *file, sqlite3_int64 *size){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->xFileSize(r, size);
+}
+int encLock(sqlite3_file *file, int lock){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->xLock(r, lock);
+}
+int encUnlock(sqlite3_file *file, int lock){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->xUnlock(r, lock);
+}
+int encCheckReservedLock(sqlite3_file *file, int *out){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->xCheckReservedLock(r, out);
+}
+int encFileControl(sqlite3_file *file, int op, void *arg){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->xFileControl(r, op, arg);
+}
+int encSectorSize(sqlite3_file *file){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->xSectorSize(r);
+}
+int encDeviceCharacteristics(sqlite3_file *file){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->xDeviceCharacteristics(r);
+}
+// the wal-index only holds page numbers and checksums, so shm passes through
+int encShmMap(sqlite3_file *file, int region, int size, int extend, void volatile **out){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->iVersion >= 2 ? r->pMethods->xShmMap(r, region, size, extend, out) : SQLITE_IOERR_SHMMAP;
+}
+int encShmLock(sqlite3_file *file, int offset, int n, int flags){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->iVersion >= 2 ? r->pMethods->xShmLock(r, offset, n, flags) : SQLITE_IOERR_SHMLOCK;
+}
+void encShmBarrier(sqlite3_file *file){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    if (r->pMethods->iVersion >= 2) r->pMethods->xShmBarrier(r);
+}
+int encShmUnmap(sqlite3_file *file, int deleteFlag){
+    sqlite3_file *r = reinterpret_cast<EncFile *>(file)->real();
+    return r->pMethods->iVersion >= 2 ? r->pMethods->xShmUnmap(r, deleteFlag) : SQLITE_OK;
+}
+
+// version 2: no xFetch, so SQLite never memory-maps (and bypasses) the ciphertext
+const sqlite3_io_methods *encMethods(){
+    static const sqlite3_io_methods methods = {
+        2, encClose, encRead, encWrite, encTruncate, encSync, encFileSize,
+        encLock, encUnlock, encCheckReservedLock, encFileControl, encSectorSize,
+        encDeviceCharacteristics, encShmMap, encShmLock, encShmBarrier, encShmUnmap,
+        nullptr, nullptr};
+    return &methods;
+}
+
+EncryptedVfs::State *stateOf(sqlite3_vfs *vfs){
+    return static_cast<EncryptedVfs::State *>(vfs->pAppData);
+}
+
+int vfsOpen(sqlite3_vfs *vfs, const char *name, sqlite3_file *file, int flags, int *outFlags){
+    EncryptedVfs::State *state = stateOf(vfs);
+    EncFile *f = reinterpret_cast<EncFile *>(file);
+    f->base.pMethods = nullptr;
+    f->state = state;
+    f->ctx = nullptr;
+    f->scratch = nullptr;
+    f->scratchSize = 0;
+    if (flags & SQLITE_OPEN_MAIN_DB) f->kind = FileKind::Main;
+    else if (flags & SQLITE_OPEN_MAIN_JOURNAL) f->kind = FileKind::Journal;
+    else if (flags & SQLITE_OPEN_WAL) f->kind = FileKind::Wal;
+    else f->kind = FileKind::Plain;
+
+    int rc = state->root->xOpen(state->root, name, f->real(), flags, outFlags);
+    if (rc != SQLITE_OK) return rc;
+    if (f->kind == FileKind::Main) {
+        uint8_t header[kHeaderBytes];
+        sqlite3_file *r = f->real();
+        if (r->pMethods->xRead(r, header, sizeof(header), 0) == SQLITE_OK) {
+            if (int pageSize = headerPageSize(header)) state->pageSize.store(pageSize, std::memory_order_relaxed);
+        }
+    }
+    if (f->kind != FileKind::Plain) {
+        f->ctx = EVP_CIPHER_CTX_new();
+        if (!f->ctx || EVP_CipherInit_ex(f->ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr, -1) != 1) {
+            EVP_CIPHER_CTX_free(f->ctx);
+            f->real()->pMethods->xClose(f->real());
+            return SQLITE_CANTOPEN;
+        }
+    }
+    f->base.pMethods = encMethods();
+    return SQLITE_OK;
+}
+
+int vfsDelete(sqlite3_vfs *vfs, const char *name, int syncDir){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    return root->xDelete(root, name, syncDir);
+}
+int vfsAccess(sqlite3_vfs *vfs, const char *name, int flags, int *out){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    return root->xAccess(root, name, flags, out);
+}
+int vfsFullPathname(sqlite3_vfs *vfs, const char *name, int size, char *out){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    return root->xFullPathname(root, name, size, out);
+}
+void *vfsDlOpen(sqlite3_vfs *vfs, const char *name){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    return root->xDlOpen(root, name);
+}
+void vfsDlError(sqlite3_vfs *vfs, int size, char *out){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    root->xDlError(root, size, out);
+}
+void (*vfsDlSym(sqlite3_vfs *vfs, void *handle, const char *symbol))(void){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    return root->xDlSym(root, handle, symbol);
+}
+void vfsDlClose(sqlite3_vfs *vfs, void *handle){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    root->xDlClose(root, handle);
+}
+int vfsRandomness(sqlite3_vfs *vfs, int size, char *out){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    return root->xRandomness(root, size, out);
+}
+int vfsSleep(sqlite3_vfs *vfs, int micros){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    return root->xSleep(root, micros);
+}
+int vfsCurrentTime(sqlite3_vfs *vfs, double *out){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    return root->xCurrentTime(root, out);
+}
+int vfsGetLastError(sqlite3_vfs *vfs, int size, char *out){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    return root->xGetLastError ? root->xGetLastError(root, size, out) : 0;
+}
+int vfsCurrentTimeInt64(sqlite3_vfs *vfs, sqlite3_int64 *out){
+    sqlite3_vfs *root = stateOf(vfs)->root;
+    return root->xCurrentTimeInt64(root, out);
+}
+
+std::atomic<unsigned> vfsCounter{0};
+
+} // namespace
+
+EncryptedVfs::EncryptedVfs(const std::vector<uint8_t> &key, const std::vector<uint8_t> &salt)
+    : m_state(std::make_unique<State>()){
+    if (key.size() != sizeof(m_state->key) || salt.size() != kSaltBytes) {
+        throw std::runtime_error("Encrypted VFS needs a 32-byte key and a 16-byte salt");
+    }
+    State &s = *m_state;
+    s.root = sqlite3_vfs_find(nullptr);
+    if (!s.root) throw std::runtime_error("No default SQLite VFS");
+    std::memcpy(s.key, key.data(), key.size());
+    std::memcpy(s.salt, salt.data(), salt.size());
+    s.name = "cryptify-enc-" + std::to_string(vfsCounter.fetch_add(1));
+
+    std::memset(&s.vfs, 0, sizeof(s.vfs));
+    s.vfs.iVersion = 2;
+    s.vfs.szOsFile = static_cast<int>(sizeof(EncFile)) + s.root->szOsFile;
+    s.vfs.mxPathname = s.root->mxPathname;
+    s.vfs.zName = s.name.c_str();
+    s.vfs.pAppData = &s;
+    s.vfs.xOpen = vfsOpen;
+    s.vfs.xDelete = vfsDelete;
+    s.vfs.xAccess = vfsAccess;
+    s.vfs.xFullPathname = vfsFullPathname;
+    s.vfs.xDlOpen = vfsDlOpen;
+    s.vfs.xDlError = vfsDlError;
+    s.vfs.xDlSym = vfsDlSym;
+    s.vfs.xDlClose = vfsDlClose;
+    s.vfs.xRandomness = vfsRandomness;
+    s.vfs.xSleep = vfsSleep;
+    s.vfs.xCurrentTime = vfsCurrentTime;
+    s.vfs.xGetLastError = vfsGetLastError;
+    s.vfs.xCurrentTimeInt64 = vfsCurrentTimeInt64;
+    if (sqlite3_vfs_register(&s.vfs, 0) != SQLITE_OK) {
+        OPENSSL_cleanse(s.key, sizeof(s.key));
+        throw std::runtime_error("Failed to register encrypted VFS");
+    }
+}
+
+EncryptedVfs::~EncryptedVfs(){
+    sqlite3_vfs_unregister(&m_state->vfs);
+    OPENSSL_cleanse(m_state->key, sizeof(m_state->key));
+}
+
+const char *EncryptedVfs::name() const{
+    return m_state->name.c_str();
+}
+
+std::vector<uint8_t> EncryptedVfs::readSalt(const std::string &path){
+    std::ifstream in(path, std::ios::binary);
+    uint8_t header[kHeaderBytes];
+    if (!in || !in.read(reinterpret_cast<char *>(header), sizeof(header))) {
+        return {}; // missing or empty: a new database
+    }
+    if (std::memcmp(header, "SQLite format 3", 16) != 0) {
+        throw std::runtime_error("Not an SQLite database: " + path);
+    }
+    const int pageSize = headerPageSize(header);
+    if (!pageSize || header[20] != kReserveBytes) {
+        throw std::runtime_error("Database is not page-encrypted: " + path);
+    }
+    std::vector<uint8_t> salt(kSaltBytes);
+    in.seekg(pageSize - kReserveBytes + kSaltOffset);
+    if (!in.read(reinterpret_cast<char *>(salt.data()), kSaltBytes)) {
+        throw std::runtime_error("Truncated encrypted database: " + path);
+    }
+    return salt;
+}
@@ -0,0 +1,157 @@
+#include "KdfExecutor.hpp"
+#include "CryptoManager.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <openssl/crypto.h>
+#include <stdexcept>
+
+KdfExecutor::KdfExecutor(unsigned workers, size_t queueCapacity) : m_capacity(std::max<size_t>(queueCapacity, 1))
+{
+    workers = std::max(workers, 1u);
+    for (unsigned i = 0; i < workers; ++i) {
+        m_workers.emplace_back(&KdfExecutor::run, this);
+    }
+}
+
+KdfExecutor::~KdfExecutor()
+{
+    {
+        std::lock_guard guard(m_lock);
+        m_stopping = true;
+    }
+    m_ready.notify_all();
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+KdfExecutor &KdfExecutor::shared()
+{
+    static KdfExecutor instance(std::max(std::thread::hardware_concurrency() / 2, 1u),
+                                64 * std::max(std::thread::hardware_concurrency() / 2, 1u));
+    return instance;
+}
+
+bool KdfExecutor::tryEnqueue(std::move_only_function<void()> job)
+{
+    {
+        std::lock_guard guard(m_lock);
+        if (m_stopping || m_queue.size() >= m_capacity) {
+            m_rejected++;
+            return false;
+        }
+        m_queue.push_back(std::move(job));
+    }
+    m_ready.notify_one();
+    return true;
+}
+
+void KdfExecutor::run()
+{
+    while (true) {
+        std::move_only_function<void()> job;
+        {
+            std::unique_lock guard(m_lock);
+            m_ready.wait(guard, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return; // stopping and drained
+            }
+            job = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        job();
+    }
+}
+
+std::future<std::vector<uint8_t>> KdfExecutor::submit(Work work)
+{
+    if (!work) {
+        throw std::invalid_argument("KdfExecutor::submit needs a job");
+    }
+    std::promise<std::vector<uint8_t>> promise;
+    auto future = promise.get_future();
+    bool accepted = tryEnqueue([promise = std::move(promise), work = std::move(work)]() mutable {
+        try {
+            promise.set_value(work());
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+    });
+    if (!accepted) {
+        CRYPTIFY_LOG(LogLevel::Debug, "KDF queue full, shedding request");
+        throw KdfOverloaded();
+    }
+    return future;
+}
+
+std::future<std::vector<uint8_t>> KdfExecutor::deriveKey(std::string pass, std::vector<uint8_t> salt)
+{
+    return submit([pass = std::move(pass), salt = std::move(salt)]() mutable {
+        auto key = CryptoManager::deriveKey(pass, salt);
+        OPENSSL_cleanse(pass.data(), pass.size());
+        return key;
+    });
+}
+
+KdfExecutor::KeyAwaiter::KeyAwaiter(KdfExecutor &executor, std::string pass, std::vector<uint8_t> salt, Resume resume)
+    : m_executor(executor), m_resume(std::move(resume)), m_pass(std::move(pass)), m_salt(std::move(salt))
+{
+}
+
+KdfExecutor::KeyAwaiter KdfExecutor::deriveKeyAsync(std::string pass, std::vector<uint8_t> salt, Resume resume)
+{
+    if (!resume) {
+        throw std::invalid_argument("deriveKeyAsync needs a Resume to hand the coroutine back to");
+    }
+    return KeyAwaiter(*this, std::move(pass), std::move(salt), std::move(resume));
+}
+
+// the awaiter lives in the suspended coroutine's frame, so the worker can
+// write the result into it directly before handing the coroutine back
+bool KdfExecutor::KeyAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    bool accepted = m_executor.tryEnqueue([this, handle] {
+        try {
+            m_key = CryptoManager::deriveKey(m_pass, m_salt);
+        } catch (...) {
+            m_error = std::current_exception();
+        }
+        OPENSSL_cleanse(m_pass.data(), m_pass.size());
+        // the coroutine may run (and free this awaiter) as soon as it is
+        // posted, so nothing of the awaiter is touched afterwards
+        Resume resume = std::move(m_resume);
+        try {
+            resume(handle);
+        } catch (const std::exception &error) {
+            CRYPTIFY_LOG(LogLevel::Error, "KDF resume callback threw, coroutine not resumed: " << error.what());
+        } catch (...) {
+            CRYPTIFY_LOG(LogLevel::Error, "KDF resume callback threw, coroutine not resumed");
+        }
+    });
+    if (!accepted) {
+        CRYPTIFY_LOG(LogLevel::Debug, "KDF queue full, shedding request");
+        m_error = std::make_exception_ptr(KdfOverloaded());
+        return false; // continue right away, await_resume throws
+    }
+    return true;
+}
+
+std::vector<uint8_t> KdfExecutor::KeyAwaiter::await_resume()
+{
+    if (m_error) {
+        std::rethrow_exception(m_error);
+    }
+    return std::move(m_key);
+}
+
+size_t KdfExecutor::queued() const
+{
+    std::lock_guard guard(m_lock);
+    return m_queue.size();
+}
+
+uint64_t KdfExecutor::rejected() const
+{
+    std::lock_guard guard(m_lock);
+    return m_rejected;
+}
@@ -0,0 +1,199 @@
+#include "KeyRotation.hpp"
+#include "CryptoManager.hpp"
+#include "KdfExecutor.hpp"
+#include "Log.hpp"
+#include "ParallelFor.hpp"
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// decrypts with the old key and re-encrypts with the new one, spreading the
+// batch over the worker threads; the first failure is rethrown on the caller
+void reEncryptBatch(std::vector<dataBase::secretRecord> &batch, const std::vector<uint8_t> &oldKey,
+                    const std::vector<uint8_t> &newKey, unsigned workers)
+{
+    parallelFor(batch.size(), workers, [&](size_t i) {
+        auto &record = batch[i];
+        auto plaintext = CryptoManager::decrypt(record.suite, record.encryptedData, oldKey, record.iv);
+        try {
+            record.suite = CryptoManager::preferredSuite();
+            record.iv = CryptoManager::generateRandomBytes(12);
+            record.encryptedData = CryptoManager::encrypt(record.suite, plaintext, newKey, record.iv);
+        } catch (...) {
+            OPENSSL_cleanse(plaintext.data(), plaintext.size());
+            throw;
+        }
+        OPENSSL_cleanse(plaintext.data(), plaintext.size());
+    });
+}
+
+// password derivations go through the shared KDF executor, so rotations
+// count against its queue bound like logins and are shed the same way
+std::vector<uint8_t> passwordKey(const std::string &password, const std::vector<uint8_t> &salt)
+{
+    return KdfExecutor::shared().deriveKey(password, salt).get();
+}
+
+std::vector<uint8_t> openedVaultKey(const std::string &password, const dataBase::UserQuerey &user)
+{
+    return KdfExecutor::shared().submit([&] {
+        return CryptoManager::openVaultKey(password, user.salt, user.wrappedKey, user.keyIv);
+    }).get();
+}
+
+dataBase::UserQuerey verifiedUser(dataBase &db, const std::string &username, const std::string &password)
+{
+    dataBase::UserQuerey user;
+    if (!db.getUser(username, user)) {
+        throw std::runtime_error("Unknown user: " + username);
+    }
+    if (CryptoManager::hashPassword(password, user.salt) != user.hash) {
+        throw std::runtime_error("Password does not match");
+    }
+    return user;
+}
+
+// moves every record from currentKey to a fresh vault key wrapped by newPassword
+RotationResult reEncryptVault(dataBase &db, const dataBase::UserQuerey &user, const std::vector<uint8_t> &currentKey,
+                              const std::string &newPassword, const RotationOptions &options)
+{
+    RotationResult result;
+
+    // 1. Start a new rotation, or pick up the keys of an interrupted one
+    dataBase::rotationState state;
+    std::vector<uint8_t> newKey;
+    if (db.getRotation(user.id, state)) {
+        if (CryptoManager::hashPassword(newPassword, state.newSalt) != state.newHash) {
+            throw RotationPending();
+        }
+        newKey = CryptoManager::unwrapKey(state.newWrappedKey, passwordKey(newPassword, state.newSalt), state.newKeyIv);
+        result.resumed = true;
+        CRYPTIFY_LOG(LogLevel::Info, "resuming key rotation for user " << user.id << " after secret " << state.lastSecretId);
+    } else {
+        state.newSalt = CryptoManager::generateRandomBytes(16);
+        state.newHash = CryptoManager::hashPassword(newPassword, state.newSalt);
+        state.newKeyIv = CryptoManager::generateRandomBytes(12);
+        newKey = CryptoManager::generateRandomBytes(32);
+        state.newWrappedKey = CryptoManager::wrapKey(newKey, passwordKey(newPassword, state.newSalt), state.newKeyIv);
+        state.lastSecretId = 0;
+        state.rollbackKeyIv = CryptoManager::generateRandomBytes(12);
+        state.rollbackWrappedKey = CryptoManager::wrapKey(newKey, currentKey, state.rollbackKeyIv);
+        if (!db.beginRotation(user.id, state)) {
+            throw std::runtime_error("Failed to record key rotation");
+        }
+    }
+
+    // 2. Stream the remaining rows batch by batch
+    int batchSize = std::max(options.batchSize, 1);
+    int cursor = state.lastSecretId;
+    while (true) {
+        auto batch = db.getSecretsAfter(user.id, cursor, batchSize);
+        if (batch.empty()) {
+            break;
+        }
+        reEncryptBatch(batch, currentKey, newKey, options.workers);
+        int last = batch.back().id;
+        if (!db.commitRotationBatch(user.id, batch, last)) {
+            throw std::runtime_error("Failed to write re-encrypted batch");
+        }
+        cursor = last;
+        result.reEncrypted += static_cast<int>(batch.size());
+        result.batches++;
+    }
+
+    // 3. Every row is under the new key, switch the credentials over
+    if (!db.finishRotation(user.id)) {
+        throw std::runtime_error("Failed to finish key rotation");
+    }
+    return result;
+}
+
+} // namespace
+
+void KeyRotation::createVaultKey(const std::string &password, const std::vector<uint8_t> &salt,
+                                 std::vector<uint8_t> &outWrappedKey, std::vector<uint8_t> &outKeyIv)
+{
+    auto vaultKey = CryptoManager::generateRandomBytes(32);
+    outKeyIv = CryptoManager::generateRandomBytes(12);
+    outWrappedKey = CryptoManager::wrapKey(vaultKey, passwordKey(password, salt), outKeyIv);
+}
+
+RotationResult KeyRotation::changePassword(dataBase &db, const std::string &username,
+                                           const std::string &oldPassword, const std::string &newPassword,
+                                           const RotationOptions &options)
+{
+    auto user = verifiedUser(db, username, oldPassword);
+    auto currentKey = openedVaultKey(oldPassword, user);
+
+    // legacy accounts and interrupted rotations need the records rewritten
+    dataBase::rotationState pending;
+    if (user.wrappedKey.empty() || db.getRotation(user.id, pending)) {
+        return reEncryptVault(db, user, currentKey, newPassword, options);
+    }
+
+    // otherwise re-wrapping the vault key is the whole password change
+    auto newSalt = CryptoManager::generateRandomBytes(16);
+    auto newKeyIv = CryptoManager::generateRandomBytes(12);
+    auto newWrappedKey = CryptoManager::wrapKey(currentKey, passwordKey(newPassword, newSalt), newKeyIv);
+    if (!db.updateCredentials(user.id, CryptoManager::hashPassword(newPassword, newSalt), newSalt, newWrappedKey, newKeyIv)) {
+        throw std::runtime_error("Failed to update credentials");
+    }
+    return RotationResult{};
+}
+
+RotationResult KeyRotation::rotateVaultKey(dataBase &db, const std::string &username, const std::string &password,
+                                           const RotationOptions &options)
+{
+    auto user = verifiedUser(db, username, password);
+    auto currentKey = openedVaultKey(password, user);
+    return reEncryptVault(db, user, currentKey, password, options);
+}
+
+RotationResult KeyRotation::abortRotation(dataBase &db, const std::string &username, const std::string &password,
+                                          const std::string &newPassword, const RotationOptions &options)
+{
+    auto user = verifiedUser(db, username, password);
+    dataBase::rotationState state;
+    if (!db.getRotation(user.id, state)) {
+        throw std::runtime_error("No key rotation in progress");
+    }
+    auto currentKey = openedVaultKey(password, user);
+    std::vector<uint8_t> newKey;
+    if (!state.rollbackWrappedKey.empty()) {
+        newKey = CryptoManager::unwrapKey(state.rollbackWrappedKey, currentKey, state.rollbackKeyIv);
+    } else if (CryptoManager::hashPassword(newPassword, state.newSalt) == state.newHash) {
+        newKey = CryptoManager::unwrapKey(state.newWrappedKey, passwordKey(newPassword, state.newSalt), state.newKeyIv);
+    } else {
+        throw std::runtime_error("This key rotation predates rollback keys, abort it with its new password");
+    }
+    CRYPTIFY_LOG(LogLevel::Info, "aborting key rotation for user " << user.id << " at secret " << state.lastSecretId);
+
+    // walk the cursor back down: every batch below it returns to the current
+    // key in the same transaction that lowers it, so a crash here leaves a
+    // rotation that can be aborted or resumed again
+    RotationResult result;
+    int batchSize = std::max(options.batchSize, 1);
+    int cursor = state.lastSecretId;
+    while (cursor > 0) {
+        auto batch = db.getSecretsUpTo(user.id, cursor, batchSize);
+        if (batch.empty()) {
+            break;
+        }
+        reEncryptBatch(batch, newKey, currentKey, options.workers);
+        int below = batch.back().id - 1;
+        if (!db.commitRotationBatch(user.id, batch, below)) {
+            throw std::runtime_error("Failed to write restored batch");
+        }
+        cursor = below;
+        result.reEncrypted += static_cast<int>(batch.size());
+        result.batches++;
+    }
+    if (!db.cancelRotation(user.id)) {
+        throw std::runtime_error("Failed to cancel key rotation");
+    }
+    OPENSSL_cleanse(newKey.data(), newKey.size());
+    return result;
+}
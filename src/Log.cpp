@@ -0,0 +1,21 @@
+#include "Log.hpp"
+#include <iostream>
+#include <iterator>
+#include <mutex>
+
+std::atomic<int> Log::s_level{CRYPTIFY_LOG_LEVEL};
+
+void Log::setLevel(LogLevel level){
+    s_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void Log::write(LogLevel level, std::string_view message){
+    static const char* names[] = {"trace", "debug", "info", "warn", "error"};
+    // Off is only a threshold for setLevel, never the level of a message
+    if (static_cast<unsigned>(level) >= std::size(names)) {
+        return;
+    }
+    static std::mutex outputLock;
+    std::lock_guard guard(outputLock);
+    std::clog << "[cryptify " << names[static_cast<int>(level)] << "] " << message << '\n';
+}
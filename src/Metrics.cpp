@@ -0,0 +1,206 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+constexpr int kOps = static_cast<int>(MetricOp::Count);
+
+struct alignas(64) Shard
+{
+    struct Op
+    {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> totalNanos{0};
+        std::atomic<uint64_t> buckets[Metrics::kBuckets]{};
+    };
+    Op ops[kOps];
+};
+
+struct Registry
+{
+    std::mutex lock;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<Shard *> unused;
+};
+
+// never destroyed, threads may still exit after static destruction
+Registry &registry()
+{
+    static Registry *instance = new Registry;
+    return *instance;
+}
+
+// claims a shard for the calling thread and gives it back on thread exit
+struct ShardLease
+{
+    Shard *shard;
+    ShardLease()
+    {
+        auto &reg = registry();
+        std::lock_guard guard(reg.lock);
+        if (!reg.unused.empty()) {
+            shard = reg.unused.back();
+            reg.unused.pop_back();
+        } else {
+            reg.shards.push_back(std::make_unique<Shard>());
+            shard = reg.shards.back().get();
+        }
+    }
+    ~ShardLease()
+    {
+        auto &reg = registry();
+        std::lock_guard guard(reg.lock);
+        reg.unused.push_back(shard);
+    }
+};
+
+Shard &localShard()
+{
+    thread_local ShardLease lease;
+    return *lease.shard;
+}
+
+// only the owning thread writes a shard, so a plain load/store is enough
+void add(std::atomic<uint64_t> &counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+int bucketFor(uint64_t nanos)
+{
+    if (nanos == 0) {
+        return 0;
+    }
+    return std::min(static_cast<int>(std::bit_width(nanos)) - 1, Metrics::kBuckets - 1);
+}
+
+// upper bound of the bucket holding the q-quantile
+uint64_t quantile(const Metrics::OpStats &stats, double q)
+{
+    if (stats.count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(stats.count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < Metrics::kBuckets; ++i) {
+        seen += stats.buckets[i];
+        if (seen >= rank) {
+            return uint64_t{1} << (i + 1);
+        }
+    }
+    return uint64_t{1} << Metrics::kBuckets;
+}
+
+} // namespace
+
+void Metrics::record(MetricOp op, uint64_t nanos)
+{
+    auto &slot = localShard().ops[static_cast<int>(op)];
+    add(slot.count, 1);
+    add(slot.totalNanos, nanos);
+    add(slot.buckets[bucketFor(nanos)], 1);
+}
+
+Metrics::OpStats Metrics::snapshot(MetricOp op)
+{
+    OpStats stats;
+    auto &reg = registry();
+    std::lock_guard guard(reg.lock);
+    for (const auto &shard : reg.shards) {
+        const auto &slot = shard->ops[static_cast<int>(op)];
+        stats.count += slot.count.load(std::memory_order_relaxed);
+        stats.totalNanos += slot.totalNanos.load(std::memory_order_relaxed);
+        for (int i = 0; i < kBuckets; ++i) {
+            stats.buckets[i] += slot.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    return stats;
+}
+
+// not exact while other threads are recording
+void Metrics::reset()
+{
+    auto &reg = registry();
+    std::lock_guard guard(reg.lock);
+    for (const auto &shard : reg.shards) {
+        for (auto &slot : shard->ops) {
+            slot.count.store(0, std::memory_order_relaxed);
+            slot.totalNanos.store(0, std::memory_order_relaxed);
+            for (auto &bucket : slot.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+const char *Metrics::name(MetricOp op)
+{
+    switch (op) {
+    case MetricOp::Kdf: return "kdf";
+    case MetricOp::Encrypt: return "encrypt";
+    case MetricOp::Decrypt: return "decrypt";
+    case MetricOp::Prepare: return "prepare";
+    case MetricOp::Step: return "step";
+    case MetricOp::Commit: return "commit";
+    case MetricOp::Count: break;
+    }
+    return "unknown";
+}
+
+std::string Metrics::prometheus()
+{
+    std::string out =
+        "# HELP cryptify_op_duration_seconds Latency of vault hot-path operations.\n"
+        "# TYPE cryptify_op_duration_seconds histogram\n";
+    char line[512];
+    for (int o = 0; o < kOps; ++o) {
+        auto op = static_cast<MetricOp>(o);
+        auto stats = snapshot(op);
+        uint64_t cumulative = 0;
+        for (int i = 0; i < kBuckets; ++i) {
+            cumulative += stats.buckets[i];
+            double le = static_cast<double>(uint64_t{1} << (i + 1)) / 1e9;
+            std::snprintf(line, sizeof(line), "cryptify_op_duration_seconds_bucket{op=\"%s\",le=\"%g\"} %llu\n",
+                          name(op), le, static_cast<unsigned long long>(cumulative));
+            out += line;
+        }
+        std::snprintf(line, sizeof(line),
+                      "cryptify_op_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n"
+                      "cryptify_op_duration_seconds_sum{op=\"%s\"} %.9f\n"
+                      "cryptify_op_duration_seconds_count{op=\"%s\"} %llu\n",
+                      name(op), static_cast<unsigned long long>(stats.count),
+                      name(op), static_cast<double>(stats.totalNanos) / 1e9,
+                      name(op), static_cast<unsigned long long>(stats.count));
+        out += line;
+    }
+    return out;
+}
+
+std::string Metrics::json()
+{
+    std::string out = "{";
+    char field[200];
+    for (int o = 0; o < kOps; ++o) {
+        auto op = static_cast<MetricOp>(o);
+        auto stats = snapshot(op);
+        std::snprintf(field, sizeof(field),
+                      "%s\"%s\":{\"count\":%llu,\"total_ns\":%llu,\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"buckets\":[",
+                      o ? "," : "", name(op),
+                      static_cast<unsigned long long>(stats.count), static_cast<unsigned long long>(stats.totalNanos),
+                      static_cast<unsigned long long>(quantile(stats, 0.5)), static_cast<unsigned long long>(quantile(stats, 0.99)),
+                      static_cast<unsigned long long>(quantile(stats, 0.999)));
+        out += field;
+        for (int i = 0; i < kBuckets; ++i) {
+            out += (i ? "," : "") + std::to_string(stats.buckets[i]);
+        }
+        out += "]}";
+    }
+    out += "}";
+    return out;
+}
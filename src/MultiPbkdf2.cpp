@@ -0,0 +1,503 @@
+#include "MultiPbkdf2.hpp"
+#include "Log.hpp"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRYPTIFY_MB_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#define MB_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CRYPTIFY_MB_X86 0
+#endif
+
+namespace {
+
+constexpr uint32_t kInit[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                               0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+alignas(64) constexpr uint32_t kRound[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+// Every iteration after the first is HMAC over a 32-byte message: one
+// compression from the inner pad state over U || padding, one from the
+// outer pad state over that digest || padding. Both blocks have the same
+// fixed tail: 0x80, zeros and the bit length of 64 + 32 bytes.
+constexpr uint32_t kPadWord = 0x80000000;
+constexpr uint32_t kLengthWord = (64 + 32) * 8;
+
+// one chain: HMAC pad states, the running U_i and the xor of all U so far
+struct Lane
+{
+    uint32_t inner[8];
+    uint32_t outer[8];
+    uint32_t u[8];
+    uint32_t t[8];
+};
+
+// ---- portable ----
+
+void compressPortable(uint32_t state[8], const uint32_t block[16])
+{
+    uint32_t w[64];
+    std::memcpy(w, block, sizeof(uint32_t) * 16);
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = std::rotr(w[i - 15], 7) ^ std::rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = std::rotr(w[i - 2], 17) ^ std::rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25)) + ((e & f) ^ (~e & g)) + kRound[i] + w[i];
+        uint32_t t2 = (std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void iteratePortable(Lane &lane, uint32_t iterations)
+{
+    uint32_t block[16] = {};
+    block[8] = kPadWord;
+    block[15] = kLengthWord;
+    for (uint32_t i = 0; i < iterations; ++i) {
+        uint32_t state[8];
+        std::memcpy(block, lane.u, sizeof(lane.u));
+        std::memcpy(state, lane.inner, sizeof(state));
+        compressPortable(state, block);
+        std::memcpy(block, state, sizeof(state));
+        std::memcpy(lane.u, lane.outer, sizeof(lane.u));
+        compressPortable(lane.u, block);
+        for (int k = 0; k < 8; ++k) lane.t[k] ^= lane.u[k];
+    }
+}
+
+#if CRYPTIFY_MB_X86
+
+// ---- SHA extensions, one lane ----
+
+MB_TARGET("sha,sse4.1") void compressShaNi(uint32_t state[8], const uint32_t block[16])
+{
+    // the SHA instructions keep the state as ABEF / CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+    const __m128i save0 = state0, save1 = state1;
+
+    __m128i msg[4];
+    for (int i = 0; i < 4; ++i) msg[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 4 * i));
+    for (int group = 0; group < 16; ++group) {
+        if (group >= 4) {
+            __m128i &next = msg[group & 3]; // holds W[t-16..t-13] until overwritten
+            next = _mm_sha256msg2_epu32(
+                _mm_add_epi32(_mm_sha256msg1_epu32(next, msg[(group + 1) & 3]),
+                              _mm_alignr_epi8(msg[(group + 3) & 3], msg[(group + 2) & 3], 4)),
+                msg[(group + 3) & 3]);
+        }
+        __m128i wk = _mm_add_epi32(msg[group & 3], _mm_load_si128(reinterpret_cast<const __m128i *>(kRound + 4 * group)));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+    }
+    state0 = _mm_add_epi32(state0, save0);
+    state1 = _mm_add_epi32(state1, save1);
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(state1, tmp, 8));
+}
+
+MB_TARGET("sha,sse4.1") void iterateShaNi(Lane &lane, uint32_t iterations)
+{
+    uint32_t block[16] = {};
+    block[8] = kPadWord;
+    block[15] = kLengthWord;
+    for (uint32_t i = 0; i < iterations; ++i) {
+        uint32_t state[8];
+        std::memcpy(block, lane.u, sizeof(lane.u));
+        std::memcpy(state, lane.inner, sizeof(state));
+        compressShaNi(state, block);
+        std::memcpy(block, state, sizeof(state));
+        std::memcpy(lane.u, lane.outer, sizeof(lane.u));
+        compressShaNi(lane.u, block);
+        for (int k = 0; k < 8; ++k) lane.t[k] ^= lane.u[k];
+    }
+}
+
+// ---- multi-buffer: word j of every lane side by side in one register ----
+//
+// The compression and iteration loop are written once against the
+// operations below and instantiated per instruction set, since GCC only
+// inlines intrinsics into functions compiled for the same target.
+
+#define MB_COMPRESS_BODY                                                                         \
+    V w[16];                                                                                     \
+    for (int i = 0; i < 16; ++i) w[i] = block[i];                                                \
+    V a = state[0], b = state[1], c = state[2], d = state[3];                                    \
+    V e = state[4], f = state[5], g = state[6], h = state[7];                                    \
+    for (int i = 0; i < 64; ++i) {                                                               \
+        if (i >= 16) {                                                                           \
+            V w15 = w[(i - 15) & 15], w2 = w[(i - 2) & 15];                                      \
+            V s0 = XOR3(ROTR(w15, 7), ROTR(w15, 18), SHR(w15, 3));                               \
+            V s1 = XOR3(ROTR(w2, 17), ROTR(w2, 19), SHR(w2, 10));                                \
+            w[i & 15] = ADD(ADD(w[i & 15], s0), ADD(w[(i - 7) & 15], s1));                       \
+        }                                                                                        \
+        V t1 = ADD(ADD(h, XOR3(ROTR(e, 6), ROTR(e, 11), ROTR(e, 25))),                           \
+                   ADD(CH(e, f, g), ADD(SET1(kRound[i]), w[i & 15])));                           \
+        V t2 = ADD(XOR3(ROTR(a, 2), ROTR(a, 13), ROTR(a, 22)), MAJ(a, b, c));                    \
+        h = g;                                                                                   \
+        g = f;                                                                                   \
+        f = e;                                                                                   \
+        e = ADD(d, t1);                                                                          \
+        d = c;                                                                                   \
+        c = b;                                                                                   \
+        b = a;                                                                                   \
+        a = ADD(t1, t2);                                                                         \
+    }                                                                                            \
+    state[0] = ADD(state[0], a);                                                                 \
+    state[1] = ADD(state[1], b);                                                                 \
+    state[2] = ADD(state[2], c);                                                                 \
+    state[3] = ADD(state[3], d);                                                                 \
+    state[4] = ADD(state[4], e);                                                                 \
+    state[5] = ADD(state[5], f);                                                                 \
+    state[6] = ADD(state[6], g);                                                                 \
+    state[7] = ADD(state[7], h);
+
+// lanes[0..count) in, zero lanes pad the rest of the register
+#define MB_ITERATE_BODY(WIDTH)                                                                   \
+    alignas(64) uint32_t column[4][WIDTH];                                                       \
+    V inner[8], outer[8], u[8], t[8];                                                            \
+    for (int j = 0; j < 8; ++j) {                                                                \
+        for (size_t k = 0; k < (WIDTH); ++k) {                                                   \
+            const bool live = k < count;                                                         \
+            column[0][k] = live ? lanes[k].inner[j] : 0;                                         \
+            column[1][k] = live ? lanes[k].outer[j] : 0;                                         \
+            column[2][k] = live ? lanes[k].u[j] : 0;                                             \
+            column[3][k] = live ? lanes[k].t[j] : 0;                                             \
+        }                                                                                        \
+        inner[j] = LOAD(column[0]);                                                              \
+        outer[j] = LOAD(column[1]);                                                              \
+        u[j] = LOAD(column[2]);                                                                  \
+        t[j] = LOAD(column[3]);                                                                  \
+    }                                                                                            \
+    V block[16];                                                                                 \
+    for (int j = 9; j < 15; ++j) block[j] = SET1(0);                                             \
+    block[8] = SET1(kPadWord);                                                                   \
+    block[15] = SET1(kLengthWord);                                                               \
+    for (uint32_t i = 0; i < iterations; ++i) {                                                  \
+        V state[8];                                                                              \
+        for (int j = 0; j < 8; ++j) {                                                            \
+            block[j] = u[j];                                                                     \
+            state[j] = inner[j];                                                                 \
+        }                                                                                        \
+        COMPRESS(state, block);                                                                  \
+        for (int j = 0; j < 8; ++j) {                                                            \
+            block[j] = state[j];                                                                 \
+            u[j] = outer[j];                                                                     \
+        }                                                                                        \
+        COMPRESS(u, block);                                                                      \
+        for (int j = 0; j < 8; ++j) t[j] = XOR(t[j], u[j]);                                      \
+    }                                                                                            \
+    for (int j = 0; j < 8; ++j) {                                                                \
+        STORE(column[0], t[j]);                                                                  \
+        for (size_t k = 0; k < count; ++k) lanes[k].t[j] = column[0][k];                         \
+    }
+
+// AVX2, 8 lanes
+#define V __m256i
+#define ADD(x, y) _mm256_add_epi32(x, y)
+#define XOR(x, y) _mm256_xor_si256(x, y)
+#define XOR3(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+#define SHR(x, n) _mm256_srli_epi32(x, n)
+#define ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define CH(x, y, z) _mm256_xor_si256(_mm256_and_si256(x, y), _mm256_andnot_si256(x, z))
+#define MAJ(x, y, z) _mm256_or_si256(_mm256_and_si256(x, y), _mm256_and_si256(z, _mm256_or_si256(x, y)))
+#define SET1(x) _mm256_set1_epi32(static_cast<int>(x))
+#define LOAD(p) _mm256_load_si256(reinterpret_cast<const __m256i *>(p))
+#define STORE(p, x) _mm256_store_si256(reinterpret_cast<__m256i *>(p), x)
+#define COMPRESS compressAvx2
+
+MB_TARGET("avx2") inline void compressAvx2(V state[8], const V block[16]) { MB_COMPRESS_BODY }
+MB_TARGET("avx2") void iterateAvx2(Lane *lanes, size_t count, uint32_t iterations) { MB_ITERATE_BODY(8) }
+
+#undef V
+#undef ADD
+#undef XOR
+#undef XOR3
+#undef SHR
+#undef ROTR
+#undef CH
+#undef MAJ
+#undef SET1
+#undef LOAD
+#undef STORE
+#undef COMPRESS
+
+// AVX-512, 16 lanes: native rotates and three-input logic
+#define V __m512i
+#define ADD(x, y) _mm512_add_epi32(x, y)
+#define XOR(x, y) _mm512_xor_si512(x, y)
+#define XOR3(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0x96)
+#define SHR(x, n) _mm512_srli_epi32(x, n)
+#define ROTR(x, n) _mm512_ror_epi32(x, n)
+#define CH(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0xCA)
+#define MAJ(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0xE8)
+#define SET1(x) _mm512_set1_epi32(static_cast<int>(x))
+#define LOAD(p) _mm512_load_si512(p)
+#define STORE(p, x) _mm512_store_si512(p, x)
+#define COMPRESS compressAvx512
+
+MB_TARGET("avx512f") inline void compressAvx512(V state[8], const V block[16]) { MB_COMPRESS_BODY }
+MB_TARGET("avx512f") void iterateAvx512(Lane *lanes, size_t count, uint32_t iterations) { MB_ITERATE_BODY(16) }
+
+#undef V
+#undef ADD
+#undef XOR
+#undef XOR3
+#undef SHR
+#undef ROTR
+#undef CH
+#undef MAJ
+#undef SET1
+#undef LOAD
+#undef STORE
+#undef COMPRESS
+#undef MB_COMPRESS_BODY
+#undef MB_ITERATE_BODY
+
+bool cpuHasShaNi()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    __builtin_cpu_init();
+    return (ebx & (1u << 29)) && __builtin_cpu_supports("sse4.1");
+}
+
+#endif // CRYPTIFY_MB_X86
+
+void runLanes(std::vector<Lane> &lanes, uint32_t iterations, MultiPbkdf2::Kernel kernel)
+{
+    using Kernel = MultiPbkdf2::Kernel;
+    size_t i = 0;
+    const size_t count = lanes.size();
+#if CRYPTIFY_MB_X86
+    // a wide register with three live lanes still beats running them one
+    // by one; the last one or two go to the single-lane kernel
+    if (kernel == Kernel::Avx512) {
+        for (; i + 2 < count; i += 16) iterateAvx512(&lanes[i], std::min<size_t>(16, count - i), iterations);
+    }
+    if (kernel == Kernel::Avx2) {
+        for (; i + 2 < count; i += 8) iterateAvx2(&lanes[i], std::min<size_t>(8, count - i), iterations);
+    }
+    if (kernel != Kernel::Portable && MultiPbkdf2::available(Kernel::ShaNi)) {
+        for (; i < count; ++i) iterateShaNi(lanes[i], iterations);
+    }
+#endif
+    for (; i < count; ++i) iteratePortable(lanes[i], iterations);
+}
+
+void toWords(const uint8_t *bytes, uint32_t words[8])
+{
+    for (int i = 0; i < 8; ++i) {
+        words[i] = (uint32_t{bytes[4 * i]} << 24) | (uint32_t{bytes[4 * i + 1]} << 16) |
+                   (uint32_t{bytes[4 * i + 2]} << 8) | bytes[4 * i + 3];
+    }
+}
+
+} // namespace
+
+bool MultiPbkdf2::available(Kernel kernel)
+{
+#if CRYPTIFY_MB_X86
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    static const bool avx512 = (__builtin_cpu_init(), __builtin_cpu_supports("avx512f"));
+    static const bool shaNi = cpuHasShaNi();
+    switch (kernel) {
+    case Kernel::Avx512: return avx512;
+    case Kernel::Avx2: return avx2;
+    case Kernel::ShaNi: return shaNi;
+    default: return true;
+    }
+#else
+    return kernel == Kernel::OpenSsl || kernel == Kernel::Portable;
+#endif
+}
+
+MultiPbkdf2::Kernel MultiPbkdf2::best()
+{
+    // a miscompiled or mis-detected kernel would derive wrong keys and lock
+    // users out, so none is used until it has matched OpenSSL once
+    static const bool verified = [] {
+        bool ok = selfTest();
+        if (!ok) {
+            CRYPTIFY_LOG(LogLevel::Error, "PBKDF2 kernels disagree with OpenSSL, falling back to it");
+        }
+        return ok;
+    }();
+    if (!verified) {
+        return Kernel::OpenSsl;
+    }
+    for (Kernel kernel : {Kernel::Avx512, Kernel::Avx2, Kernel::ShaNi}) {
+        if (available(kernel)) return kernel;
+    }
+    return Kernel::Portable;
+}
+
+const char *MultiPbkdf2::name(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::OpenSsl: return "openssl";
+    case Kernel::Portable: return "portable";
+    case Kernel::ShaNi: return "sha-ni";
+    case Kernel::Avx2: return "avx2";
+    case Kernel::Avx512: return "avx512";
+    }
+    return "unknown";
+}
+
+std::vector<std::vector<uint8_t>> MultiPbkdf2::derive(const std::vector<std::string> &passwords,
+                                                      const std::vector<std::vector<uint8_t>> &salts,
+                                                      uint32_t iterations, size_t keyLength, Kernel kernel)
+{
+    if (passwords.size() != salts.size()) {
+        throw std::runtime_error("PBKDF2 batch needs one salt per password");
+    }
+    if (iterations == 0 || keyLength == 0) {
+        throw std::runtime_error("PBKDF2 needs at least one iteration and one output byte");
+    }
+    if (!available(kernel)) {
+        throw std::runtime_error(std::string("PBKDF2 kernel not available: ") + name(kernel));
+    }
+    std::vector<std::vector<uint8_t>> keys(passwords.size(), std::vector<uint8_t>(keyLength));
+
+    if (kernel == Kernel::OpenSsl) {
+        for (size_t i = 0; i < passwords.size(); ++i) {
+            if (PKCS5_PBKDF2_HMAC(passwords[i].data(), static_cast<int>(passwords[i].size()), salts[i].data(),
+                                  static_cast<int>(salts[i].size()), static_cast<int>(iterations), EVP_sha256(),
+                                  static_cast<int>(keyLength), keys[i].data()) != 1) {
+                throw std::runtime_error("Failed to derive key");
+            }
+        }
+        return keys;
+    }
+
+    // 1. per password: pad states and U_1 of every output block
+    const size_t blocks = (keyLength + SHA256_DIGEST_LENGTH - 1) / SHA256_DIGEST_LENGTH;
+    std::vector<Lane> lanes(passwords.size() * blocks);
+    for (size_t i = 0; i < passwords.size(); ++i) {
+        uint8_t key[64] = {};
+        if (passwords[i].size() > sizeof(key)) {
+            SHA256(reinterpret_cast<const uint8_t *>(passwords[i].data()), passwords[i].size(), key);
+        } else {
+            std::memcpy(key, passwords[i].data(), passwords[i].size());
+        }
+        uint32_t innerBlock[16], outerBlock[16];
+        for (int k = 0; k < 16; ++k) {
+            uint32_t word = (uint32_t{key[4 * k]} << 24) | (uint32_t{key[4 * k + 1]} << 16) |
+                            (uint32_t{key[4 * k + 2]} << 8) | key[4 * k + 3];
+            innerBlock[k] = word ^ 0x36363636;
+            outerBlock[k] = word ^ 0x5c5c5c5c;
+        }
+        uint32_t inner[8], outer[8];
+        std::memcpy(inner, kInit, sizeof(inner));
+        std::memcpy(outer, kInit, sizeof(outer));
+        compressPortable(inner, innerBlock);
+        compressPortable(outer, outerBlock);
+
+        std::vector<uint8_t> message(salts[i]);
+        message.resize(salts[i].size() + 4);
+        for (size_t b = 0; b < blocks; ++b) {
+            const uint32_t index = static_cast<uint32_t>(b + 1);
+            for (int k = 0; k < 4; ++k) message[salts[i].size() + k] = static_cast<uint8_t>(index >> (24 - 8 * k));
+            uint8_t first[SHA256_DIGEST_LENGTH];
+            unsigned int length = 0;
+            if (!HMAC(EVP_sha256(), passwords[i].data(), static_cast<int>(passwords[i].size()), message.data(),
+                      message.size(), first, &length)) {
+                throw std::runtime_error("Failed to derive key");
+            }
+            Lane &lane = lanes[i * blocks + b];
+            std::memcpy(lane.inner, inner, sizeof(inner));
+            std::memcpy(lane.outer, outer, sizeof(outer));
+            toWords(first, lane.u);
+            std::memcpy(lane.t, lane.u, sizeof(lane.t));
+            OPENSSL_cleanse(first, sizeof(first));
+        }
+        OPENSSL_cleanse(key, sizeof(key));
+        OPENSSL_cleanse(innerBlock, sizeof(innerBlock));
+        OPENSSL_cleanse(outerBlock, sizeof(outerBlock));
+    }
+
+    // 2. iterations 2..c
+    runLanes(lanes, iterations - 1, kernel);
+
+    // 3. T_1 || T_2 || ..., big-endian, truncated to keyLength
+    for (size_t i = 0; i < passwords.size(); ++i) {
+        for (size_t offset = 0; offset < keyLength; ++offset) {
+            const uint32_t word = lanes[i * blocks + offset / 32].t[(offset % 32) / 4];
+            keys[i][offset] = static_cast<uint8_t>(word >> (24 - 8 * (offset % 4)));
+        }
+    }
+    OPENSSL_cleanse(lanes.data(), lanes.size() * sizeof(Lane));
+    return keys;
+}
+
+bool MultiPbkdf2::selfTest()
+{
+    // empty, short, block-sized and hashed (> 64 byte) passwords; batch sizes
+    // that leave part-filled registers; one and several output blocks
+    std::vector<std::string> passwords;
+    std::vector<std::vector<uint8_t>> salts;
+    for (int i = 0; i < 37; ++i) {
+        passwords.push_back(std::string(static_cast<size_t>(i * 7 % 90), static_cast<char>('a' + i % 26)));
+        salts.push_back(std::vector<uint8_t>(static_cast<size_t>(i % 3 == 0 ? 16 : i), static_cast<uint8_t>(i)));
+    }
+    for (uint32_t iterations : {1u, 2u, 64u}) {
+        for (size_t keyLength : {size_t{32}, size_t{20}, size_t{80}}) {
+            auto expected = derive(passwords, salts, iterations, keyLength, Kernel::OpenSsl);
+            for (Kernel kernel : {Kernel::Portable, Kernel::ShaNi, Kernel::Avx2, Kernel::Avx512}) {
+                if (!available(kernel)) continue;
+                for (size_t batch : {size_t{1}, size_t{5}, passwords.size()}) {
+                    std::vector<std::string> somePasswords(passwords.begin(), passwords.begin() + batch);
+                    std::vector<std::vector<uint8_t>> someSalts(salts.begin(), salts.begin() + batch);
+                    auto keys = derive(somePasswords, someSalts, iterations, keyLength, kernel);
+                    if (!std::equal(keys.begin(), keys.end(), expected.begin())) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,166 @@
+#include "PasswordGenerator.hpp"
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+
+RandomStream::RandomStream(size_t bufferSize) : m_buffer(std::max<size_t>(bufferSize, 64)), m_pos(m_buffer.size()){}
+
+RandomStream::~RandomStream(){
+    OPENSSL_cleanse(m_buffer.data(), m_buffer.size());
+}
+
+void RandomStream::refill(){
+    if (RAND_bytes(m_buffer.data(), static_cast<int>(m_buffer.size())) != 1) {
+        throw std::runtime_error("Failed to generate random bytes");
+    }
+    m_pos = 0;
+}
+
+uint8_t RandomStream::nextByte(){
+    if (m_pos == m_buffer.size()) refill();
+    uint8_t value = m_buffer[m_pos];
+    m_buffer[m_pos++] = 0; // handed-out randomness does not stay in memory
+    return value;
+}
+
+uint32_t RandomStream::nextWord(){
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) value = (value << 8) | nextByte();
+    return value;
+}
+
+uint32_t RandomStream::uniform(uint32_t bound){
+    if (bound < 2) return 0;
+    // single bytes for alphabets, 32-bit words for wordlists; values at or
+    // above the largest multiple of bound are redrawn
+    if (bound <= 256) {
+        const uint32_t limit = 256 - 256 % bound;
+        uint32_t value;
+        do value = nextByte(); while (value >= limit);
+        return value % bound;
+    }
+    const uint64_t range = uint64_t{1} << 32;
+    const uint64_t limit = range - range % bound;
+    uint64_t value;
+    do value = nextWord(); while (value >= limit);
+    return static_cast<uint32_t>(value % bound);
+}
+
+namespace {
+
+std::string withoutAmbiguous(std::string chars){
+    std::erase_if(chars, [](char c) { return std::string_view("0Oo1lI|").find(c) != std::string_view::npos; });
+    return chars;
+}
+
+} // namespace
+
+PasswordGenerator::PasswordGenerator(const PasswordPolicy &policy) : m_policy(policy){
+    std::vector<std::string> classes;
+    if (policy.lower) classes.push_back("abcdefghijklmnopqrstuvwxyz");
+    if (policy.upper) classes.push_back("ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+    if (policy.digits) classes.push_back("0123456789");
+    if (policy.symbols) classes.push_back(policy.symbolSet);
+    for (auto &chars : classes) {
+        if (policy.excludeAmbiguous) chars = withoutAmbiguous(chars);
+        // a character listed twice would be drawn twice as often
+        for (char c : chars) {
+            if (m_alphabet.find(c) == std::string::npos) m_alphabet += c;
+        }
+        if (!chars.empty()) m_classes.push_back(chars);
+    }
+    if (m_alphabet.size() < 2) {
+        throw std::runtime_error("Password policy allows fewer than two characters");
+    }
+    if (policy.length == 0 || (policy.requireEachClass && policy.length < m_classes.size())) {
+        throw std::runtime_error("Password policy length is too short");
+    }
+}
+
+std::string PasswordGenerator::generate(){
+    const uint32_t size = static_cast<uint32_t>(m_alphabet.size());
+    std::string password(m_policy.length, '\0');
+    for (;;) {
+        for (char &c : password) c = m_alphabet[m_random.uniform(size)];
+        if (!m_policy.requireEachClass) return password;
+        bool complete = std::all_of(m_classes.begin(), m_classes.end(), [&](const std::string &chars) {
+            return password.find_first_of(chars) != std::string::npos;
+        });
+        if (complete) return password;
+        OPENSSL_cleanse(password.data(), password.size());
+    }
+}
+
+std::vector<std::string> PasswordGenerator::generate(size_t count){
+    std::vector<std::string> passwords;
+    passwords.reserve(count);
+    for (size_t i = 0; i < count; ++i) passwords.push_back(generate());
+    return passwords;
+}
+
+double PasswordGenerator::entropyBits() const{
+    return m_policy.length * std::log2(static_cast<double>(m_alphabet.size()));
+}
+
+PassphraseGenerator::PassphraseGenerator(std::vector<std::string> wordlist, const PassphrasePolicy &policy)
+    : m_words(std::move(wordlist)), m_policy(policy){
+    std::sort(m_words.begin(), m_words.end());
+    m_words.erase(std::unique(m_words.begin(), m_words.end()), m_words.end());
+    std::erase(m_words, std::string{});
+    if (m_words.size() < 2) {
+        throw std::runtime_error("Passphrase wordlist needs at least two distinct words");
+    }
+    if (policy.words == 0) {
+        throw std::runtime_error("Passphrase policy needs at least one word");
+    }
+}
+
+std::string PassphraseGenerator::generate(){
+    const uint32_t size = static_cast<uint32_t>(m_words.size());
+    const size_t digitAfter = m_policy.appendDigit ? m_random.uniform(static_cast<uint32_t>(m_policy.words)) : 0;
+    std::string phrase;
+    for (size_t i = 0; i < m_policy.words; ++i) {
+        if (i > 0) phrase += m_policy.separator;
+        size_t start = phrase.size();
+        phrase += m_words[m_random.uniform(size)];
+        if (m_policy.capitalize) phrase[start] = static_cast<char>(std::toupper(static_cast<unsigned char>(phrase[start])));
+        if (m_policy.appendDigit && i == digitAfter) phrase += static_cast<char>('0' + m_random.uniform(10));
+    }
+    return phrase;
+}
+
+std::vector<std::string> PassphraseGenerator::generate(size_t count){
+    std::vector<std::string> phrases;
+    phrases.reserve(count);
+    for (size_t i = 0; i < count; ++i) phrases.push_back(generate());
+    return phrases;
+}
+
+double PassphraseGenerator::entropyBits() const{
+    double bits = m_policy.words * std::log2(static_cast<double>(m_words.size()));
+    if (m_policy.appendDigit) bits += std::log2(10.0 * m_policy.words);
+    return bits;
+}
+
+std::vector<std::string> PassphraseGenerator::loadWordlist(const std::string &path){
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Cannot open wordlist: " + path);
+    }
+    std::vector<std::string> words;
+    std::unordered_set<std::string> seen;
+    std::string line;
+    while (std::getline(in, line)) {
+        while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back()))) line.pop_back();
+        size_t start = line.find_last_of(" \t");
+        std::string word = start == std::string::npos ? line : line.substr(start + 1);
+        if (!word.empty() && seen.insert(word).second) words.push_back(std::move(word));
+    }
+    return words;
+}
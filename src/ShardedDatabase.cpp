@@ -0,0 +1,119 @@
+#include "ShardedDatabase.hpp"
+#include "Log.hpp"
+#include <limits>
+#include <stdexcept>
+
+struct ShardedDatabase::Shard
+{
+    std::mutex lock;
+    std::unique_ptr<dataBase> db;
+};
+
+namespace {
+
+// FNV-1a: routing has to stay the same across runs, builds and platforms,
+// which std::hash does not promise
+uint64_t routingHash(const std::string &key){
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+ShardedDatabase::ShardedDatabase(const std::string &basePath, unsigned shards) : m_basePath(basePath){
+    if (shards == 0 || shards > static_cast<unsigned>(std::numeric_limits<int>::max())) {
+        throw std::runtime_error("ShardedDatabase needs between 1 and INT_MAX shards");
+    }
+    for (unsigned i = 0; i < shards; ++i) {
+        m_shards.push_back(std::make_unique<Shard>());
+    }
+}
+
+ShardedDatabase::~ShardedDatabase() = default;
+
+unsigned ShardedDatabase::shardCount() const{
+    return static_cast<unsigned>(m_shards.size());
+}
+
+unsigned ShardedDatabase::shardOf(const std::string &username) const{
+    return static_cast<unsigned>(routingHash(username) % m_shards.size());
+}
+
+std::string ShardedDatabase::shardPath(unsigned shard) const{
+    const std::string suffix = ".shard" + std::to_string(shard);
+    size_t dot = m_basePath.find_last_of('.');
+    size_t slash = m_basePath.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return m_basePath + suffix;
+    }
+    return m_basePath.substr(0, dot) + suffix + m_basePath.substr(dot);
+}
+
+// caller holds shard.lock
+dataBase &ShardedDatabase::open(Shard &shard, unsigned index){
+    if (!shard.db) {
+        CRYPTIFY_LOG(LogLevel::Debug, "opening shard " << index);
+        shard.db = std::make_unique<dataBase>(shardPath(index));
+    }
+    return *shard.db;
+}
+
+// false when the encoded id does not fit the int ids of the dataBase API;
+// a shard's local ids may use the whole int range, the global ones only 1/N
+bool ShardedDatabase::globalId(int localId, unsigned shard, int &outId) const{
+    const int64_t id = int64_t{localId} * static_cast<int64_t>(m_shards.size()) + shard;
+    if (localId < 0 || id > std::numeric_limits<int>::max()) {
+        CRYPTIFY_LOG(LogLevel::Error, "id " << localId << " on shard " << shard << " does not fit a sharded id");
+        return false;
+    }
+    outId = static_cast<int>(id);
+    return true;
+}
+
+bool ShardedDatabase::addUser(const std::string &username, const std::vector<uint8_t> &hash, const std::vector<uint8_t> &salt,
+                              const std::vector<uint8_t> &wrappedKey, const std::vector<uint8_t> &keyIv){
+    unsigned index = shardOf(username);
+    Shard &shard = *m_shards[index];
+    std::lock_guard guard(shard.lock);
+    return open(shard, index).addUser(username, hash, salt, wrappedKey, keyIv);
+}
+
+bool ShardedDatabase::getUser(const std::string &username, dataBase::UserQuerey &outData){
+    unsigned index = shardOf(username);
+    Shard &shard = *m_shards[index];
+    std::lock_guard guard(shard.lock);
+    if (!open(shard, index).getUser(username, outData)) {
+        return false;
+    }
+    return globalId(outData.id, index, outData.id);
+}
+
+bool ShardedDatabase::addSecret(int userId, const std::string &title, const std::vector<uint8_t> &encryptedData,
+                                const std::vector<uint8_t> &iv, CipherSuite suite, uint8_t flags){
+    if (userId < 0) return false;
+    unsigned index = static_cast<unsigned>(userId) % m_shards.size();
+    Shard &shard = *m_shards[index];
+    std::lock_guard guard(shard.lock);
+    return open(shard, index).addSecret(userId / static_cast<int>(m_shards.size()), title, encryptedData, iv, suite, flags);
+}
+
+std::vector<dataBase::secretRecord> ShardedDatabase::getSecrets(int userId){
+    if (userId < 0) return {};
+    unsigned index = static_cast<unsigned>(userId) % m_shards.size();
+    Shard &shard = *m_shards[index];
+    std::vector<dataBase::secretRecord> records;
+    {
+        std::lock_guard guard(shard.lock);
+        records = open(shard, index).getSecrets(userId / static_cast<int>(m_shards.size()));
+    }
+    for (auto &record : records) {
+        if (!globalId(record.id, index, record.id)) {
+            return {};
+        }
+    }
+    return records;
+}
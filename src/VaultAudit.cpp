@@ -0,0 +1,177 @@
+#include "VaultAudit.hpp"
+#include "BreachCorpus.hpp"
+#include "Compression.hpp"
+#include "CryptoManager.hpp"
+#include "ParallelFor.hpp"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+using Tag = std::array<uint8_t, 32>;
+
+// everything kept per record once its plaintext is gone
+struct RecordState
+{
+    int secretId;
+    std::string title;
+    int64_t createdAt;
+    bool readable;
+    int score;
+    double entropyBits;
+    uint32_t breachCount;
+    Tag tag;
+};
+
+void inspect(const dataBase::secretRecord &record, const std::vector<uint8_t> &vaultKey, const Tag &runKey,
+             const AuditOptions &options, RecordState &state)
+{
+    state.secretId = record.id;
+    state.title = record.title;
+    state.createdAt = record.createdAt;
+    std::vector<uint8_t> plaintext;
+    try {
+        plaintext = CryptoManager::decrypt(record.suite, record.encryptedData, vaultKey, record.iv);
+        Compression::unpack(plaintext, record.flags);
+    } catch (const std::exception &) {
+        OPENSSL_cleanse(plaintext.data(), plaintext.size());
+        state.readable = false;
+        return;
+    }
+    state.readable = true;
+    std::string_view password(reinterpret_cast<const char *>(plaintext.data()), plaintext.size());
+    state.score = VaultAudit::score(password, &state.entropyBits);
+    state.breachCount = options.breaches ? options.breaches->occurrences(password) : 0;
+    unsigned int length = 0;
+    HMAC(EVP_sha256(), runKey.data(), static_cast<int>(runKey.size()), plaintext.data(), plaintext.size(),
+         state.tag.data(), &length);
+    OPENSSL_cleanse(plaintext.data(), plaintext.size());
+}
+
+void inspectBatch(const std::vector<dataBase::secretRecord> &batch, const std::vector<uint8_t> &vaultKey,
+                  const Tag &runKey, const AuditOptions &options, std::vector<RecordState> &out)
+{
+    out.assign(batch.size(), RecordState{});
+    parallelFor(batch.size(), options.workers, [&](size_t i) {
+        inspect(batch[i], vaultKey, runKey, options, out[i]);
+    });
+}
+
+bool isRun(char a, char b, char c)
+{
+    return (b - a == 1 && c - b == 1) || (a - b == 1 && b - c == 1);
+}
+
+} // namespace
+
+int VaultAudit::score(std::string_view password, double *entropyBits)
+{
+    bool lower = false, upper = false, digit = false, symbol = false, other = false;
+    for (unsigned char c : password) {
+        if (c >= 'a' && c <= 'z') lower = true;
+        else if (c >= 'A' && c <= 'Z') upper = true;
+        else if (c >= '0' && c <= '9') digit = true;
+        else if (c >= 0x20 && c < 0x7f) symbol = true;
+        else other = true;
+    }
+    double pool = (lower ? 26 : 0) + (upper ? 26 : 0) + (digit ? 10 : 0) + (symbol ? 33 : 0) + (other ? 100 : 0);
+    // a character costs full price only when it is new and does not extend
+    // a run; repeats and sequences add a quarter
+    double effective = 0;
+    std::array<bool, 256> seen{};
+    for (size_t i = 0; i < password.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(password[i]);
+        bool cheap = seen[c] || (i >= 2 && isRun(password[i - 2], password[i - 1], password[i]));
+        effective += cheap ? 0.25 : 1.0;
+        seen[c] = true;
+    }
+    double bits = pool > 1 ? effective * std::log2(pool) : 0;
+    if (entropyBits) *entropyBits = bits;
+    if (bits < 28) return 0;
+    if (bits < 36) return 1;
+    if (bits < 60) return 2;
+    if (bits < 80) return 3;
+    return 4;
+}
+
+AuditSummary VaultAudit::run(dataBase &db, int userId, const std::vector<uint8_t> &vaultKey,
+                             const std::function<void(const AuditFinding &)> &onFinding, const AuditOptions &options)
+{
+    Tag runKey;
+    auto random = CryptoManager::generateRandomBytes(static_cast<int>(runKey.size()));
+    std::copy(random.begin(), random.end(), runKey.begin());
+    OPENSSL_cleanse(random.data(), random.size());
+
+    // 1. decrypt and inspect every record, keeping only tags and scores
+    std::vector<RecordState> states;
+    std::map<std::string, size_t> current; // title -> newest state
+    std::vector<RecordState> batchStates;
+    const int batchSize = std::max(options.batchSize, 1);
+    int cursor = 0;
+    for (;;) {
+        auto batch = db.getSecretsAfter(userId, cursor, batchSize);
+        if (batch.empty()) {
+            break;
+        }
+        inspectBatch(batch, vaultKey, runKey, options, batchStates);
+        for (auto &state : batchStates) {
+            current[state.title] = states.size(); // ids ascend, so later wins
+            states.push_back(std::move(state));
+        }
+        cursor = batch.back().id;
+    }
+    OPENSSL_cleanse(runKey.data(), runKey.size());
+
+    // 2. reuse across current records
+    std::vector<size_t> live;
+    live.reserve(current.size());
+    for (const auto &[title, index] : current) live.push_back(index);
+    std::sort(live.begin(), live.end());
+    std::map<Tag, int> tagCounts;
+    for (size_t index : live) {
+        if (states[index].readable) ++tagCounts[states[index].tag];
+    }
+
+    // 3. report
+    const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                            std::chrono::system_clock::now().time_since_epoch()).count();
+    AuditSummary summary;
+    for (size_t index : live) {
+        const RecordState &state = states[index];
+        AuditFinding finding{state.secretId, state.title, 0, 0, 0.0, -1, 0, 0};
+        if (state.createdAt > 0) {
+            finding.ageDays = std::max<int64_t>(now - state.createdAt, 0) / 86400;
+            if (finding.ageDays > options.maxAgeDays) finding.flags |= AuditOld;
+        }
+        if (!state.readable) {
+            finding.flags |= AuditUnreadable;
+        } else {
+            finding.score = state.score;
+            finding.entropyBits = state.entropyBits;
+            finding.breachCount = state.breachCount;
+            finding.reuseCount = tagCounts[state.tag];
+            if (finding.reuseCount > 1) finding.flags |= AuditReused;
+            if (finding.breachCount > 0) {
+                finding.flags |= AuditBreached;
+                finding.score = 0;
+            }
+            if (finding.score < options.weakScore) finding.flags |= AuditWeak;
+        }
+        ++summary.records;
+        if (finding.flags & AuditReused) ++summary.reused;
+        if (finding.flags & AuditWeak) ++summary.weak;
+        if (finding.flags & AuditOld) ++summary.old;
+        if (finding.flags & AuditBreached) ++summary.breached;
+        if (finding.flags & AuditUnreadable) ++summary.unreadable;
+        if (onFinding) onFinding(finding);
+    }
+    return summary;
+}
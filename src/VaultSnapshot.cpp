@@ -0,0 +1,283 @@
+#include "VaultSnapshot.hpp"
+#include "Compression.hpp"
+#include "CryptoManager.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::endian::native == std::endian::little, "snapshot format is little-endian");
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'R', 'Y', 'S', 'N', 'A', 'P', '1'};
+constexpr uint32_t kVersion = 1;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint16_t saltLength;
+    uint16_t wrappedKeyLength;
+    uint16_t keyIvLength;
+    uint16_t reserved0;
+    uint64_t keyBlockOffset;
+    uint64_t indexOffset;
+    uint64_t stringsOffset;
+    uint64_t dataOffset;
+    uint64_t fileSize;
+};
+static_assert(sizeof(Header) <= 64);
+constexpr size_t kHeaderSize = 64;
+
+struct IndexEntry
+{
+    uint32_t titleOffset; // relative to the strings section
+    uint32_t titleLength;
+    uint64_t dataOffset;  // relative to the data section
+    uint32_t dataLength;  // IV + ciphertext
+    uint8_t ivLength;
+    uint8_t suite;
+    uint8_t flags;
+    uint8_t reserved0;
+    uint64_t reserved1;
+};
+static_assert(sizeof(IndexEntry) == 32);
+
+template <typename T>
+T load(const uint8_t *at)
+{
+    T value;
+    std::memcpy(&value, at, sizeof(T));
+    return value;
+}
+
+// Flushes tempPath to disk and swaps it in for path, so readers see the old
+// snapshot or the new one, never none or a truncated one, even across a crash.
+bool publish(const std::string &tempPath, const std::string &path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    bool synced = FlushFileBuffers(file);
+    CloseHandle(file);
+    // rename() does not replace an existing file on Windows
+    return synced && MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    int fd = ::open(tempPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    if (!synced || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        return false;
+    }
+    // and the directory entry
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    int dir = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (dir >= 0) {
+        ::fsync(dir);
+        ::close(dir);
+    }
+    return true;
+#endif
+}
+
+} // namespace
+
+bool VaultSnapshot::exportUser(dataBase &db, const std::string &username, const std::string &path)
+{
+    dataBase::UserQuerey user;
+    if (!db.getUser(username, user)) {
+        return false;
+    }
+    // records up to the cursor are under a key the snapshot could not open
+    dataBase::rotationState rotation;
+    if (db.getRotation(user.id, rotation)) {
+        CRYPTIFY_LOG(LogLevel::Warn, "not exporting user " << user.id << " during a key rotation");
+        return false;
+    }
+
+    // newest record per title, sorted by title bytes
+    std::map<std::string, dataBase::secretRecord> latest;
+    for (auto &record : db.getSecrets(user.id)) {
+        auto it = latest.find(record.title);
+        if (it == latest.end() || it->second.id < record.id) {
+            latest[record.title] = std::move(record);
+        }
+    }
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.count = static_cast<uint32_t>(latest.size());
+    header.saltLength = static_cast<uint16_t>(user.salt.size());
+    header.wrappedKeyLength = static_cast<uint16_t>(user.wrappedKey.size());
+    header.keyIvLength = static_cast<uint16_t>(user.keyIv.size());
+    header.keyBlockOffset = kHeaderSize;
+
+    std::vector<IndexEntry> index;
+    std::string strings;
+    uint64_t dataSize = 0;
+    for (const auto &[title, record] : latest) {
+        IndexEntry entry{};
+        entry.titleOffset = static_cast<uint32_t>(strings.size());
+        entry.titleLength = static_cast<uint32_t>(title.size());
+        entry.dataOffset = dataSize;
+        entry.dataLength = static_cast<uint32_t>(record.iv.size() + record.encryptedData.size());
+        entry.ivLength = static_cast<uint8_t>(record.iv.size());
+        entry.suite = static_cast<uint8_t>(record.suite);
+        entry.flags = record.flags;
+        strings += title;
+        dataSize += entry.dataLength;
+        index.push_back(entry);
+    }
+
+    uint64_t keyBlockSize = user.salt.size() + user.wrappedKey.size() + user.keyIv.size();
+    // keep the index 8-byte aligned in the mapping
+    header.indexOffset = (header.keyBlockOffset + keyBlockSize + 7) & ~uint64_t{7};
+    header.stringsOffset = header.indexOffset + index.size() * sizeof(IndexEntry);
+    header.dataOffset = header.stringsOffset + strings.size();
+    header.fileSize = header.dataOffset + dataSize;
+
+    // a name of its own in the destination directory, so concurrent exports
+    // to the same path never write into each other's file
+    std::string tempPath = path + ".";
+    for (uint8_t byte : CryptoManager::generateRandomBytes(8)) {
+        tempPath += "0123456789abcdef"[byte >> 4];
+        tempPath += "0123456789abcdef"[byte & 15];
+    }
+    tempPath += ".tmp";
+    bool written = false;
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        char headerBytes[kHeaderSize] = {};
+        std::memcpy(headerBytes, &header, sizeof(header));
+        out.write(headerBytes, kHeaderSize);
+        out.write(reinterpret_cast<const char *>(user.salt.data()), user.salt.size());
+        out.write(reinterpret_cast<const char *>(user.wrappedKey.data()), user.wrappedKey.size());
+        out.write(reinterpret_cast<const char *>(user.keyIv.data()), user.keyIv.size());
+        const char padding[8] = {};
+        out.write(padding, header.indexOffset - header.keyBlockOffset - keyBlockSize);
+        out.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(IndexEntry));
+        out.write(strings.data(), strings.size());
+        for (const auto &[title, record] : latest) {
+            out.write(reinterpret_cast<const char *>(record.iv.data()), record.iv.size());
+            out.write(reinterpret_cast<const char *>(record.encryptedData.data()), record.encryptedData.size());
+        }
+        out.close();
+        written = !out.fail();
+    }
+    // removed only once closed, Windows cannot delete an open file
+    if (!written || !publish(tempPath, path)) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+VaultSnapshot::VaultSnapshot(const std::string &path) : m_file(path)
+{
+    auto bytes = m_file.bytes();
+    if (bytes.size() < kHeaderSize) {
+        throw std::runtime_error("Not a vault snapshot: " + path);
+    }
+    auto header = load<Header>(bytes.data());
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+        throw std::runtime_error("Not a vault snapshot: " + path);
+    }
+    // Offsets come from the file, so every bound is checked against what is
+    // left of the file (size <= fileSize - offset) before anything is added:
+    // sums of crafted values could wrap.
+    const uint64_t fileSize = bytes.size();
+    const uint64_t keyBlockSize = uint64_t{header.saltLength} + header.wrappedKeyLength + header.keyIvLength;
+    if (header.fileSize != fileSize ||
+        header.keyBlockOffset < kHeaderSize || header.keyBlockOffset > fileSize ||
+        keyBlockSize > fileSize - header.keyBlockOffset ||
+        header.indexOffset < header.keyBlockOffset + keyBlockSize || header.indexOffset > fileSize ||
+        header.count > (fileSize - header.indexOffset) / sizeof(IndexEntry) ||
+        header.stringsOffset != header.indexOffset + uint64_t{header.count} * sizeof(IndexEntry) ||
+        header.dataOffset < header.stringsOffset || header.dataOffset > fileSize) {
+        throw std::runtime_error("Corrupt vault snapshot: " + path);
+    }
+
+    auto keyBlock = bytes.subspan(header.keyBlockOffset, keyBlockSize);
+    m_salt = keyBlock.subspan(0, header.saltLength);
+    m_wrappedKey = keyBlock.subspan(header.saltLength, header.wrappedKeyLength);
+    m_keyIv = keyBlock.subspan(header.saltLength + header.wrappedKeyLength, header.keyIvLength);
+    m_count = header.count;
+    m_index = bytes.data() + header.indexOffset;
+    m_strings = bytes.subspan(header.stringsOffset, header.dataOffset - header.stringsOffset);
+    m_data = bytes.subspan(header.dataOffset);
+    m_file.adviseRandom();
+}
+
+VaultSnapshot::Entry VaultSnapshot::entryAt(size_t index) const
+{
+    auto raw = load<IndexEntry>(m_index + index * sizeof(IndexEntry));
+    if (uint64_t{raw.titleOffset} + raw.titleLength > m_strings.size() || raw.dataOffset > m_data.size() ||
+        raw.dataLength > m_data.size() - raw.dataOffset || raw.ivLength > raw.dataLength) {
+        throw std::runtime_error("Corrupt vault snapshot entry");
+    }
+    auto data = m_data.subspan(raw.dataOffset, raw.dataLength);
+    return Entry{
+        std::string_view(reinterpret_cast<const char *>(m_strings.data()) + raw.titleOffset, raw.titleLength),
+        data.first(raw.ivLength),
+        data.subspan(raw.ivLength),
+        static_cast<CipherSuite>(raw.suite),
+        raw.flags,
+    };
+}
+
+std::optional<VaultSnapshot::Entry> VaultSnapshot::find(std::string_view title) const
+{
+    size_t low = 0;
+    size_t high = m_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        auto entry = entryAt(mid);
+        if (entry.title < title) {
+            low = mid + 1;
+        } else if (title < entry.title) {
+            high = mid;
+        } else {
+            return entry;
+        }
+    }
+    return std::nullopt;
+}
+
+std::vector<uint8_t> VaultSnapshot::unlock(const std::string &password) const
+{
+    std::vector<uint8_t> salt(m_salt.begin(), m_salt.end());
+    std::vector<uint8_t> wrappedKey(m_wrappedKey.begin(), m_wrappedKey.end());
+    std::vector<uint8_t> keyIv(m_keyIv.begin(), m_keyIv.end());
+    return CryptoManager::openVaultKey(password, salt, wrappedKey, keyIv);
+}
+
+std::vector<uint8_t> VaultSnapshot::open(const Entry &entry, const std::vector<uint8_t> &vaultKey)
+{
+    std::vector<uint8_t> iv(entry.iv.begin(), entry.iv.end());
+    std::vector<uint8_t> ciphertext(entry.ciphertext.begin(), entry.ciphertext.end());
+    auto plaintext = CryptoManager::decrypt(entry.suite, ciphertext, vaultKey, iv);
+    Compression::unpack(plaintext, entry.flags);
+    return plaintext;
+}
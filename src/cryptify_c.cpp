@@ -0,0 +1,404 @@
+#include "cryptify.h"
+#include "Compression.hpp"
+#include "CryptoManager.hpp"
+#include "KdfExecutor.hpp"
+#include "KeyRotation.hpp"
+#include "Metrics.hpp"
+#include "VaultSnapshot.hpp"
+#include "dBase.hpp"
+#include <openssl/crypto.h>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+
+struct cryptify_vault
+{
+    std::unique_ptr<dataBase> db;
+    std::mutex lock;
+    int userId = -1;
+    std::vector<uint8_t> vaultKey;
+
+    void lockKey()
+    {
+        OPENSSL_cleanse(vaultKey.data(), vaultKey.size());
+        vaultKey.clear();
+        userId = -1;
+    }
+};
+
+struct cryptify_snapshot
+{
+    VaultSnapshot snapshot;
+    std::vector<uint8_t> vaultKey;
+
+    explicit cryptify_snapshot(const char *path) : snapshot(path) {}
+    ~cryptify_snapshot() { OPENSSL_cleanse(vaultKey.data(), vaultKey.size()); }
+};
+
+namespace {
+
+bool empty(const char *s)
+{
+    return s == nullptr || *s == '\0';
+}
+
+// keeps exceptions from crossing the C boundary
+template <typename F>
+cryptify_status guarded(F &&body, cryptify_status onError)
+{
+    try {
+        return body();
+    } catch (const std::bad_alloc &) {
+        return CRYPTIFY_ERR_NO_MEMORY;
+    } catch (const KdfOverloaded &) {
+        return CRYPTIFY_ERR_BUSY;
+    } catch (...) {
+        return onError;
+    }
+}
+
+// copies plaintext into a caller-owned, NUL-terminated buffer and wipes it
+cryptify_status handOut(std::vector<uint8_t> &plaintext, uint8_t **out_data, size_t *out_length)
+{
+    // malloc(0) may return null, always hand back a freeable pointer
+    auto *buffer = static_cast<uint8_t *>(std::malloc(plaintext.size() + 1));
+    if (buffer == nullptr) {
+        OPENSSL_cleanse(plaintext.data(), plaintext.size());
+        return CRYPTIFY_ERR_NO_MEMORY;
+    }
+    std::memcpy(buffer, plaintext.data(), plaintext.size());
+    buffer[plaintext.size()] = 0;
+    OPENSSL_cleanse(plaintext.data(), plaintext.size());
+    *out_data = buffer;
+    *out_length = plaintext.size();
+    return CRYPTIFY_OK;
+}
+
+} // namespace
+
+extern "C" {
+
+uint32_t cryptify_abi_version(void)
+{
+    return CRYPTIFY_ABI_VERSION;
+}
+
+const char *cryptify_status_string(cryptify_status status)
+{
+    switch (status) {
+    case CRYPTIFY_OK: return "ok";
+    case CRYPTIFY_ERR_ARGUMENT: return "invalid argument";
+    case CRYPTIFY_ERR_DATABASE: return "database error";
+    case CRYPTIFY_ERR_AUTH: return "authentication failed";
+    case CRYPTIFY_ERR_EXISTS: return "user already exists";
+    case CRYPTIFY_ERR_NOT_FOUND: return "secret not found";
+    case CRYPTIFY_ERR_LOCKED: return "vault is locked";
+    case CRYPTIFY_ERR_CRYPTO: return "decryption failed";
+    case CRYPTIFY_ERR_NO_MEMORY: return "out of memory";
+    case CRYPTIFY_ERR_BUSY: return "key derivation queue is full";
+    case CRYPTIFY_ERR_ROTATING: return "key rotation pending, resume or abort it";
+    }
+    return "unknown status";
+}
+
+cryptify_status cryptify_open(const char *path, cryptify_vault **out_vault)
+{
+    if (empty(path) || out_vault == nullptr) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    *out_vault = nullptr;
+    return guarded([&] {
+        auto vault = std::make_unique<cryptify_vault>();
+        vault->db = std::make_unique<dataBase>(path);
+        *out_vault = vault.release();
+        return CRYPTIFY_OK;
+    }, CRYPTIFY_ERR_DATABASE);
+}
+
+void cryptify_close(cryptify_vault *vault)
+{
+    if (vault) {
+        vault->lockKey();
+        delete vault;
+    }
+}
+
+cryptify_status cryptify_register(cryptify_vault *vault, const char *username, const char *password)
+{
+    if (vault == nullptr || empty(username) || empty(password)) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    return guarded([&] {
+        std::lock_guard guard(vault->lock);
+        dataBase::UserQuerey existing;
+        if (vault->db->getUser(username, existing)) {
+            return CRYPTIFY_ERR_EXISTS;
+        }
+        auto salt = CryptoManager::generateRandomBytes(16);
+        std::vector<uint8_t> wrappedKey, keyIv;
+        KeyRotation::createVaultKey(password, salt, wrappedKey, keyIv);
+        if (!vault->db->addUser(username, CryptoManager::hashPassword(password, salt), salt, wrappedKey, keyIv)) {
+            return CRYPTIFY_ERR_DATABASE;
+        }
+        return CRYPTIFY_OK;
+    }, CRYPTIFY_ERR_DATABASE);
+}
+
+cryptify_status cryptify_login(cryptify_vault *vault, const char *username, const char *password)
+{
+    if (vault == nullptr || empty(username) || password == nullptr) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    return guarded([&] {
+        std::lock_guard guard(vault->lock);
+        vault->lockKey();
+        dataBase::UserQuerey user;
+        if (!vault->db->getUser(username, user) || CryptoManager::hashPassword(password, user.salt) != user.hash) {
+            return CRYPTIFY_ERR_AUTH;
+        }
+        vault->vaultKey = KdfExecutor::shared().submit([&] {
+            return CryptoManager::openVaultKey(password, user.salt, user.wrappedKey, user.keyIv);
+        }).get();
+        vault->userId = user.id;
+        return CRYPTIFY_OK;
+    }, CRYPTIFY_ERR_CRYPTO);
+}
+
+void cryptify_logout(cryptify_vault *vault)
+{
+    if (vault) {
+        std::lock_guard guard(vault->lock);
+        vault->lockKey();
+    }
+}
+
+cryptify_status cryptify_change_password(cryptify_vault *vault, const char *username,
+                                         const char *old_password, const char *new_password)
+{
+    if (vault == nullptr || empty(username) || old_password == nullptr || empty(new_password)) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    return guarded([&] {
+        std::lock_guard guard(vault->lock);
+        dataBase::UserQuerey user;
+        if (!vault->db->getUser(username, user) || CryptoManager::hashPassword(old_password, user.salt) != user.hash) {
+            return CRYPTIFY_ERR_AUTH;
+        }
+        try {
+            KeyRotation::changePassword(*vault->db, username, old_password, new_password);
+        } catch (const RotationPending &) {
+            return CRYPTIFY_ERR_ROTATING;
+        }
+        // a legacy account may have been moved to a new vault key
+        if (vault->userId == user.id) {
+            vault->lockKey();
+        }
+        return CRYPTIFY_OK;
+    }, CRYPTIFY_ERR_DATABASE);
+}
+
+cryptify_status cryptify_abort_rotation(cryptify_vault *vault, const char *username, const char *password)
+{
+    if (vault == nullptr || empty(username) || password == nullptr) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    return guarded([&] {
+        std::lock_guard guard(vault->lock);
+        dataBase::UserQuerey user;
+        if (!vault->db->getUser(username, user) || CryptoManager::hashPassword(password, user.salt) != user.hash) {
+            return CRYPTIFY_ERR_AUTH;
+        }
+        dataBase::rotationState rotation;
+        if (!vault->db->getRotation(user.id, rotation)) {
+            return CRYPTIFY_ERR_NOT_FOUND;
+        }
+        KeyRotation::abortRotation(*vault->db, username, password);
+        return CRYPTIFY_OK;
+    }, CRYPTIFY_ERR_DATABASE);
+}
+
+cryptify_status cryptify_add_secret(cryptify_vault *vault, const char *title, const uint8_t *data, size_t length)
+{
+    return cryptify_add_secret_ex(vault, title, data, length, 0);
+}
+
+cryptify_status cryptify_add_secret_ex(cryptify_vault *vault, const char *title, const uint8_t *data, size_t length,
+                                       uint32_t options)
+{
+    if (vault == nullptr || empty(title) || (data == nullptr && length > 0)) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    return guarded([&] {
+        std::lock_guard guard(vault->lock);
+        if (vault->userId < 0) {
+            return CRYPTIFY_ERR_LOCKED;
+        }
+        std::string plaintext(reinterpret_cast<const char *>(data), length);
+        uint8_t flags = (options & CRYPTIFY_COMPRESS) ? Compression::pack(plaintext) : 0;
+        auto iv = CryptoManager::generateRandomBytes(12);
+        auto suite = CryptoManager::preferredSuite();
+        auto encrypted = CryptoManager::encrypt(suite, plaintext, vault->vaultKey, iv);
+        OPENSSL_cleanse(plaintext.data(), plaintext.size());
+        if (!vault->db->addSecret(vault->userId, title, encrypted, iv, suite, flags)) {
+            return CRYPTIFY_ERR_DATABASE;
+        }
+        return CRYPTIFY_OK;
+    }, CRYPTIFY_ERR_CRYPTO);
+}
+
+cryptify_status cryptify_get_secret(cryptify_vault *vault, const char *title, uint8_t **out_data, size_t *out_length)
+{
+    if (vault == nullptr || empty(title) || out_data == nullptr || out_length == nullptr) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    *out_data = nullptr;
+    *out_length = 0;
+    return guarded([&] {
+        std::lock_guard guard(vault->lock);
+        if (vault->userId < 0) {
+            return CRYPTIFY_ERR_LOCKED;
+        }
+        dataBase::secretRecord record;
+        if (!vault->db->getSecret(vault->userId, title, record)) {
+            return CRYPTIFY_ERR_NOT_FOUND;
+        }
+        // already under the key of an unfinished rotation
+        dataBase::rotationState rotation;
+        if (vault->db->getRotation(vault->userId, rotation) && record.id <= rotation.lastSecretId) {
+            return CRYPTIFY_ERR_ROTATING;
+        }
+        auto plaintext = CryptoManager::decrypt(record.suite, record.encryptedData, vault->vaultKey, record.iv);
+        Compression::unpack(plaintext, record.flags);
+        return handOut(plaintext, out_data, out_length);
+    }, CRYPTIFY_ERR_CRYPTO);
+}
+
+cryptify_status cryptify_list_titles(cryptify_vault *vault, char ***out_titles, size_t *out_count)
+{
+    if (vault == nullptr || out_titles == nullptr || out_count == nullptr) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    *out_titles = nullptr;
+    *out_count = 0;
+    return guarded([&] {
+        std::lock_guard guard(vault->lock);
+        if (vault->userId < 0) {
+            return CRYPTIFY_ERR_LOCKED;
+        }
+        auto records = vault->db->getSecrets(vault->userId);
+        auto **titles = static_cast<char **>(std::calloc(records.size() + 1, sizeof(char *)));
+        if (titles == nullptr) {
+            return CRYPTIFY_ERR_NO_MEMORY;
+        }
+        for (size_t i = 0; i < records.size(); ++i) {
+            titles[i] = static_cast<char *>(std::malloc(records[i].title.size() + 1));
+            if (titles[i] == nullptr) {
+                cryptify_free_titles(titles, i);
+                return CRYPTIFY_ERR_NO_MEMORY;
+            }
+            std::memcpy(titles[i], records[i].title.c_str(), records[i].title.size() + 1);
+        }
+        *out_titles = titles;
+        *out_count = records.size();
+        return CRYPTIFY_OK;
+    }, CRYPTIFY_ERR_DATABASE);
+}
+
+cryptify_status cryptify_snapshot_export(cryptify_vault *vault, const char *username, const char *path)
+{
+    if (vault == nullptr || empty(username) || empty(path)) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    return guarded([&] {
+        std::lock_guard guard(vault->lock);
+        dataBase::UserQuerey user;
+        dataBase::rotationState rotation;
+        if (vault->db->getUser(username, user) && vault->db->getRotation(user.id, rotation)) {
+            return CRYPTIFY_ERR_ROTATING;
+        }
+        return VaultSnapshot::exportUser(*vault->db, username, path) ? CRYPTIFY_OK : CRYPTIFY_ERR_DATABASE;
+    }, CRYPTIFY_ERR_DATABASE);
+}
+
+cryptify_status cryptify_snapshot_open(const char *path, const char *password, cryptify_snapshot **out_snapshot)
+{
+    if (empty(path) || password == nullptr || out_snapshot == nullptr) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    *out_snapshot = nullptr;
+    std::unique_ptr<cryptify_snapshot> snapshot;
+    cryptify_status status = guarded([&] {
+        snapshot = std::make_unique<cryptify_snapshot>(path);
+        return CRYPTIFY_OK;
+    }, CRYPTIFY_ERR_DATABASE);
+    if (status != CRYPTIFY_OK) {
+        return status;
+    }
+    return guarded([&] {
+        snapshot->vaultKey = KdfExecutor::shared().submit([&] {
+            return snapshot->snapshot.unlock(password);
+        }).get();
+        *out_snapshot = snapshot.release();
+        return CRYPTIFY_OK;
+    }, CRYPTIFY_ERR_AUTH);
+}
+
+cryptify_status cryptify_snapshot_get(cryptify_snapshot *snapshot, const char *title, uint8_t **out_data, size_t *out_length)
+{
+    if (snapshot == nullptr || empty(title) || out_data == nullptr || out_length == nullptr) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    *out_data = nullptr;
+    *out_length = 0;
+    return guarded([&] {
+        auto entry = snapshot->snapshot.find(title);
+        if (!entry) {
+            return CRYPTIFY_ERR_NOT_FOUND;
+        }
+        auto plaintext = VaultSnapshot::open(*entry, snapshot->vaultKey);
+        return handOut(plaintext, out_data, out_length);
+    }, CRYPTIFY_ERR_CRYPTO);
+}
+
+void cryptify_snapshot_close(cryptify_snapshot *snapshot)
+{
+    delete snapshot;
+}
+
+cryptify_status cryptify_metrics(cryptify_metrics_format format, char **out_text)
+{
+    if (out_text == nullptr) {
+        return CRYPTIFY_ERR_ARGUMENT;
+    }
+    *out_text = nullptr;
+    return guarded([&] {
+        std::string text = format == CRYPTIFY_METRICS_JSON ? Metrics::json() : Metrics::prometheus();
+        auto *buffer = static_cast<char *>(std::malloc(text.size() + 1));
+        if (buffer == nullptr) {
+            return CRYPTIFY_ERR_NO_MEMORY;
+        }
+        std::memcpy(buffer, text.c_str(), text.size() + 1);
+        *out_text = buffer;
+        return CRYPTIFY_OK;
+    }, CRYPTIFY_ERR_NO_MEMORY);
+}
+
+void cryptify_free(void *buffer)
+{
+    std::free(buffer);
+}
+
+void cryptify_free_titles(char **titles, size_t count)
+{
+    if (titles == nullptr) {
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        std::free(titles[i]);
+    }
+    std::free(titles);
+}
+
+} // extern "C"
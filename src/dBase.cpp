@@ -1,23 +1,100 @@
 #include "dBase.hpp"
+#include "CryptoManager.hpp"
+#include "EncryptedVfs.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
+#include <openssl/crypto.h>
 
+// column list shared by every query that returns secretRecord rows
+#define SECRET_COLUMNS "id, title, encrypted_data, iv, suite, flags, created_at"
+
+namespace {
+
+void readSecretRow(sqlite3_stmt* stmt, dataBase::secretRecord& record){
+    record.id = sqlite3_column_int(stmt, 0);
+    record.title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    const uint8_t* data = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 2));
+    record.encryptedData.assign(data, data + sqlite3_column_bytes(stmt, 2));
+    const uint8_t* iv = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 3));
+    record.iv.assign(iv, iv + sqlite3_column_bytes(stmt, 3));
+    record.suite = static_cast<CipherSuite>(sqlite3_column_int(stmt, 4));
+    record.flags = static_cast<uint8_t>(sqlite3_column_int(stmt, 5));
+    record.createdAt = sqlite3_column_int64(stmt, 6);
+}
+
+// staging copies left by backups that were interrupted by a crash
+void removeStaleBackups(){
+    static std::once_flag once;
+    std::call_once(once, BackupStaging::removeStale);
+}
+
+} // namespace
 
 dataBase::dataBase(const std::string& path) : m_db{nullptr}{
-    std::cout << "Initializing database... \n";
-    auto exit = sqlite3_open(path.c_str(),&m_db);
+    CRYPTIFY_LOG(LogLevel::Debug, "opening database " << path);
+    removeStaleBackups();
+    // serialized: a scheduled backup shares this connection from its own thread
+    auto exit = sqlite3_open_v2(path.c_str(), &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, nullptr);
     if (exit != SQLITE_OK){
         std::string err = sqlite3_errmsg(m_db);
         sqlite3_close(m_db);
         throw std::runtime_error("failed to open DB");
     }
+    createTables();
+};
+
+dataBase::dataBase(const std::string& path, const std::string& passphrase) : m_db{nullptr}{
+    CRYPTIFY_LOG(LogLevel::Debug, "opening encrypted database " << path);
+    removeStaleBackups();
+    std::vector<uint8_t> salt = EncryptedVfs::readSalt(path);
+    if (salt.empty()) {
+        salt = CryptoManager::generateRandomBytes(EncryptedVfs::kSaltBytes);
+    }
+    std::vector<uint8_t> key = CryptoManager::deriveKey(passphrase, salt);
+    m_vfs = std::make_unique<EncryptedVfs>(key, salt);
+    OPENSSL_cleanse(key.data(), key.size());
+
+    auto exit = sqlite3_open_v2(path.c_str(), &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX,
+                                m_vfs->name());
+    if (exit != SQLITE_OK){
+        sqlite3_close(m_db);
+        throw std::runtime_error("failed to open DB");
+    }
+    // room for IV and tag at the end of every page; only takes effect while
+    // the file is still empty, readSalt() has checked existing files
+    int reserve = EncryptedVfs::kReserveBytes;
+    sqlite3_file_control(m_db, "main", SQLITE_FCNTL_RESERVE_BYTES, &reserve);
+    // temp files bypass the encryption, keep them off the disk
+    if (!exec("PRAGMA temp_store = MEMORY;")) {
+        sqlite3_close(m_db);
+        throw std::runtime_error("failed to open DB");
+    }
+    // the first page read fails authentication on a wrong passphrase
+    if (sqlite3_exec(m_db, "SELECT count(*) FROM sqlite_schema;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        sqlite3_close(m_db);
+        throw std::runtime_error("Failed to open encrypted database: wrong passphrase or corrupted file");
+    }
+    createTables();
+};
+
+void dataBase::createTables(){
     const std::string sql = 
         "PRAGMA foreign_keys = ON;" 
         "CREATE TABLE IF NOT EXISTS users ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT, "
         "username TEXT UNIQUE NOT NULL, "
         "password_hash BLOB NOT NULL, "
-        "salt BLOB NOT NULL);"
+        "salt BLOB NOT NULL, "
+        "wrapped_key BLOB, "
+        "key_iv BLOB);"
         
         "CREATE TABLE IF NOT EXISTS secrets ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT, "
@@ -25,7 +102,38 @@ dataBase::dataBase(const std::string& path) : m_db{nullptr}{
         "title TEXT NOT NULL, "
         "encrypted_data BLOB NOT NULL, "
         "iv BLOB NOT NULL, "
-        "FOREIGN KEY(user_id) REFERENCES users(id) ON DELETE CASCADE);";
+        "suite INTEGER NOT NULL DEFAULT 1, "
+        "flags INTEGER NOT NULL DEFAULT 0, "
+        "created_at INTEGER NOT NULL DEFAULT 0, "
+        "FOREIGN KEY(user_id) REFERENCES users(id) ON DELETE CASCADE);"
+
+        "CREATE TABLE IF NOT EXISTS key_rotations ("
+        "user_id INTEGER PRIMARY KEY, "
+        "new_hash BLOB NOT NULL, "
+        "new_salt BLOB NOT NULL, "
+        "new_wrapped_key BLOB, "
+        "new_key_iv BLOB, "
+        "last_secret_id INTEGER NOT NULL DEFAULT 0, "
+        "rollback_wrapped_key BLOB, "
+        "rollback_key_iv BLOB, "
+        "FOREIGN KEY(user_id) REFERENCES users(id) ON DELETE CASCADE);"
+
+        // no foreign keys: tombstones outlive their secret (and user)
+        "CREATE TABLE IF NOT EXISTS secrets_changelog ("
+        "seq INTEGER PRIMARY KEY AUTOINCREMENT, "
+        "user_id INTEGER NOT NULL, "
+        "secret_id INTEGER NOT NULL, "
+        "op INTEGER NOT NULL, "
+        "changed_at INTEGER NOT NULL DEFAULT (CAST(strftime('%s', 'now') AS INTEGER)));"
+        "CREATE INDEX IF NOT EXISTS secrets_changelog_user ON secrets_changelog(user_id, seq);"
+        "CREATE INDEX IF NOT EXISTS secrets_changelog_secret ON secrets_changelog(secret_id, seq);";
+    // the changelog of an older database starts with one insert per existing secret
+    bool hadChangelog = false;
+    sqlite3_stmt* probe;
+    if (sqlite3_prepare_v2(m_db, "SELECT 1 FROM sqlite_schema WHERE type = 'table' AND name = 'secrets_changelog';", -1, &probe, nullptr) == SQLITE_OK) {
+        hadChangelog = sqlite3_step(probe) == SQLITE_ROW;
+        sqlite3_finalize(probe);
+    }
     char* error_msg = nullptr;
     int exec_result = sqlite3_exec(m_db, sql.c_str(), nullptr, nullptr, &error_msg);
     if (exec_result != SQLITE_OK) {
@@ -34,43 +142,98 @@ dataBase::dataBase(const std::string& path) : m_db{nullptr}{
         sqlite3_close(m_db);     
         throw std::runtime_error("Failed to create tables: " + err);
     }
+    // databases created by older versions lack the newer columns
+    if (!ensureColumn("users", "wrapped_key", "BLOB") || !ensureColumn("users", "key_iv", "BLOB") ||
+        !ensureColumn("key_rotations", "new_wrapped_key", "BLOB") || !ensureColumn("key_rotations", "new_key_iv", "BLOB") ||
+        !ensureColumn("key_rotations", "rollback_wrapped_key", "BLOB") || !ensureColumn("key_rotations", "rollback_key_iv", "BLOB") ||
+        !ensureColumn("secrets", "suite", "INTEGER NOT NULL DEFAULT 1") ||
+        !ensureColumn("secrets", "flags", "INTEGER NOT NULL DEFAULT 0") ||
+        !ensureColumn("secrets", "created_at", "INTEGER NOT NULL DEFAULT 0")) {
+        sqlite3_close(m_db);
+        throw std::runtime_error("Failed to migrate tables");
+    }
+    if (!hadChangelog && !exec("INSERT INTO secrets_changelog (user_id, secret_id, op) SELECT user_id, id, 1 FROM secrets ORDER BY id;")) {
+        sqlite3_close(m_db);
+        throw std::runtime_error("Failed to migrate tables");
+    }
+    const char* triggers =
+        "CREATE TRIGGER IF NOT EXISTS secrets_log_insert AFTER INSERT ON secrets BEGIN "
+        "INSERT INTO secrets_changelog (user_id, secret_id, op) VALUES (NEW.user_id, NEW.id, 1); END;"
+        "CREATE TRIGGER IF NOT EXISTS secrets_log_update AFTER UPDATE ON secrets BEGIN "
+        "INSERT INTO secrets_changelog (user_id, secret_id, op) VALUES (NEW.user_id, NEW.id, 2); END;"
+        "CREATE TRIGGER IF NOT EXISTS secrets_log_delete AFTER DELETE ON secrets BEGIN "
+        "INSERT INTO secrets_changelog (user_id, secret_id, op) VALUES (OLD.user_id, OLD.id, 3); END;";
+    if (!exec(triggers)) {
+        sqlite3_close(m_db);
+        throw std::runtime_error("Failed to create changelog triggers");
+    }
     
-    std::cout << "Database initialized successfully.\n";
-
-};
+    CRYPTIFY_LOG(LogLevel::Debug, "database initialized");
+}
 
 
 dataBase::~dataBase(){
-    std::cout << "Closing database connection. \n";
+    CRYPTIFY_LOG(LogLevel::Debug, "closing database connection");
+    stopBackups();
     if (m_db){
         sqlite3_close(m_db);
     }
+    m_db = nullptr;
 };
 
-bool dataBase::addUser(const std::string &username, const std::vector<uint8_t> &hash, const std::vector<uint8_t> &salt){
-    std::cout << "adding a new user to the database. \n";
-    const char* sql = "INSERT INTO users (username, password_hash, salt) VALUES (?, ?, ?);";
+bool dataBase::setBusyTimeout(int milliseconds){
+    return sqlite3_busy_timeout(m_db, milliseconds) == SQLITE_OK;
+}
+
+int dataBase::lastError() const{
+    return sqlite3_errcode(m_db);
+}
+
+bool dataBase::addUser(const std::string &username, const std::vector<uint8_t> &hash, const std::vector<uint8_t> &salt,
+                       const std::vector<uint8_t> &wrappedKey, const std::vector<uint8_t> &keyIv){
+    CRYPTIFY_LOG(LogLevel::Debug, "adding user " << username);
+    const char* sql = "INSERT INTO users (username, password_hash, salt, wrapped_key, key_iv) VALUES (?, ?, ?, ?, ?);";
     sqlite3_stmt* stmt; ////what is this ??
-    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    if (prepare(sql, &stmt) != SQLITE_OK) {
         return false; 
     }
     sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_blob(stmt, 2, hash.data(), hash.size(), SQLITE_TRANSIENT);
     sqlite3_bind_blob(stmt, 3, salt.data(), salt.size(), SQLITE_TRANSIENT);
-    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_bind_blob(stmt, 4, wrappedKey.data(), wrappedKey.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 5, keyIv.data(), keyIv.size(), SQLITE_TRANSIENT);
+    bool success = (step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
     
     return success;    
 }
+
+// a password change only re-wraps the vault key, so this is the whole write
+bool dataBase::updateCredentials(int userId, const std::vector<uint8_t> &hash, const std::vector<uint8_t> &salt,
+                                 const std::vector<uint8_t> &wrappedKey, const std::vector<uint8_t> &keyIv){
+    const char* sql = "UPDATE users SET password_hash = ?, salt = ?, wrapped_key = ?, key_iv = ? WHERE id = ?;";
+    sqlite3_stmt* stmt;
+    if (prepare(sql, &stmt) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_blob(stmt, 1, hash.data(), hash.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 2, salt.data(), salt.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 3, wrappedKey.data(), wrappedKey.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 4, keyIv.data(), keyIv.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 5, userId);
+    bool success = (step(stmt) == SQLITE_DONE) && sqlite3_changes(m_db) == 1;
+    sqlite3_finalize(stmt);
+    return success;
+}
 bool dataBase::PrintUser(const std::string &username){
     std::cout << "searching for user in the database. \n";
     sqlite3_stmt* stmt;
     const char* sql = "SELECT username, password_hash, salt FROM users WHERE username = ?;";
-    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    if (prepare(sql, &stmt) != SQLITE_OK) {
         return false; 
     }
     sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
-    if(sqlite3_step(stmt) == SQLITE_ROW){
+    if(step(stmt) == SQLITE_ROW){
         std::cout << "username : " << sqlite3_column_text(stmt, 0 ) << "\n";
         std::string outHash ="";
         const void* hashBlob = sqlite3_column_blob(stmt, 1);
@@ -89,13 +252,13 @@ bool dataBase::PrintUser(const std::string &username){
 
 bool dataBase::getUser(const std::string &username, UserQuerey &outData){
     sqlite3_stmt *stmt;
-    const char* sql= "SELECT id, password_hash, salt FROM users WHERE username = ?;";
-    if(sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK){
+    const char* sql= "SELECT id, password_hash, salt, wrapped_key, key_iv FROM users WHERE username = ?;";
+    if(prepare(sql, &stmt) != SQLITE_OK){
         return false;
     }
     sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
-    if(sqlite3_step(stmt) == SQLITE_ROW){  
-        std::cout << "found user...\n";  
+    if(step(stmt) == SQLITE_ROW){  
+        CRYPTIFY_LOG(LogLevel::Trace, "found user " << username);
         outData.id = sqlite3_column_int(stmt, 0 );
         std::string outHash ="";
         const void* hashBlob = sqlite3_column_blob(stmt, 1);
@@ -110,6 +273,10 @@ bool dataBase::getUser(const std::string &username, UserQuerey &outData){
             const uint8_t* data = static_cast<const uint8_t*>(saltBlob);
             outData.salt.assign(data, data + saltSize);
         }
+        const uint8_t* wrapped = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 3));
+        outData.wrappedKey.assign(wrapped, wrapped + sqlite3_column_bytes(stmt, 3));
+        const uint8_t* keyIv = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 4));
+        outData.keyIv.assign(keyIv, keyIv + sqlite3_column_bytes(stmt, 4));
         sqlite3_finalize(stmt);
         return true;
     }
@@ -118,18 +285,22 @@ bool dataBase::getUser(const std::string &username, UserQuerey &outData){
 
 };
 
-bool dataBase::addSecret(int userId, const std::string &title, const std::vector<uint8_t> &encryptedData, const std::vector<uint8_t> &iv){
-    std::cout << "adding a new user to the database. \n";
-    const char* sql = "INSERT INTO secrets (user_id, title, encrypted_data, iv) VALUES (?, ?, ?, ?);";
+bool dataBase::addSecret(int userId, const std::string &title, const std::vector<uint8_t> &encryptedData, const std::vector<uint8_t> &iv,
+                         CipherSuite suite, uint8_t flags){
+    CRYPTIFY_LOG(LogLevel::Trace, "adding secret for user " << userId);
+    const char* sql = "INSERT INTO secrets (user_id, title, encrypted_data, iv, suite, flags, created_at) "
+                      "VALUES (?, ?, ?, ?, ?, ?, CAST(strftime('%s', 'now') AS INTEGER));";
     sqlite3_stmt* stmt; ////what is this ??
-    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    if (prepare(sql, &stmt) != SQLITE_OK) {
         return false; 
     }
     sqlite3_bind_int(stmt, 1, userId);
     sqlite3_bind_text(stmt, 2, title.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_blob(stmt, 3, encryptedData.data(), encryptedData.size(), SQLITE_TRANSIENT);
     sqlite3_bind_blob(stmt, 4, iv.data(), iv.size(), SQLITE_TRANSIENT);
-    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_bind_int(stmt, 5, static_cast<int>(suite));
+    sqlite3_bind_int(stmt, 6, flags);
+    bool success = (step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
     
     return success;  
@@ -139,31 +310,474 @@ std::vector<dataBase::secretRecord> dataBase::getSecrets(int userId){
     sqlite3_stmt *stmt;
     std::vector<secretRecord> results;
 
-    const char* sql= "SELECT title, encrypted_data, iv FROM secrets WHERE user_id = ?;";
-    if(sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK){
+    const char* sql= "SELECT " SECRET_COLUMNS " FROM secrets WHERE user_id = ?;";
+    if(prepare(sql, &stmt) != SQLITE_OK){
         return results;
     }
     sqlite3_bind_int(stmt, 1, userId);
-    while(sqlite3_step(stmt) == SQLITE_ROW){ 
+    while(step(stmt) == SQLITE_ROW){ 
         secretRecord record; 
-        record.title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        const void* encryptedDataBlob = sqlite3_column_blob(stmt, 1);
-        int encryptedDataSize = sqlite3_column_bytes(stmt, 1);
-        if (encryptedDataBlob && encryptedDataSize > 0) {
-            const uint8_t* data = static_cast<const uint8_t*>(encryptedDataBlob);
-            record.encryptedData.assign(data, data + encryptedDataSize);
+        readSecretRow(stmt, record);
+        results.push_back(std::move(record));
+    }
+    sqlite3_finalize(stmt);
+    return results;
+
+};
+
+// newest secret with the given title
+bool dataBase::getSecret(int userId, const std::string &title, secretRecord &outRecord){
+    sqlite3_stmt *stmt;
+    const char* sql= "SELECT " SECRET_COLUMNS " FROM secrets WHERE user_id = ? AND title = ? ORDER BY id DESC LIMIT 1;";
+    if(prepare(sql, &stmt) != SQLITE_OK){
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, userId);
+    sqlite3_bind_text(stmt, 2, title.c_str(), -1, SQLITE_TRANSIENT);
+    bool found = false;
+    if(step(stmt) == SQLITE_ROW){
+        readSecretRow(stmt, outRecord);
+        found = true;
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// streams a user's secrets in id order, one page at a time
+std::vector<dataBase::secretRecord> dataBase::getSecretsAfter(int userId, int afterId, int limit){
+    sqlite3_stmt *stmt;
+    std::vector<secretRecord> results;
+
+    const char* sql= "SELECT " SECRET_COLUMNS " FROM secrets WHERE user_id = ? AND id > ? ORDER BY id LIMIT ?;";
+    if(prepare(sql, &stmt) != SQLITE_OK){
+        return results;
+    }
+    sqlite3_bind_int(stmt, 1, userId);
+    sqlite3_bind_int(stmt, 2, afterId);
+    sqlite3_bind_int(stmt, 3, limit);
+    while(step(stmt) == SQLITE_ROW){
+        secretRecord record;
+        readSecretRow(stmt, record);
+        results.push_back(std::move(record));
+    }
+    sqlite3_finalize(stmt);
+    return results;
+}
+
+std::vector<dataBase::secretRecord> dataBase::getSecretsUpTo(int userId, int upToId, int limit){
+    sqlite3_stmt *stmt;
+    std::vector<secretRecord> results;
+
+    const char* sql= "SELECT " SECRET_COLUMNS " FROM secrets WHERE user_id = ? AND id <= ? ORDER BY id DESC LIMIT ?;";
+    if(prepare(sql, &stmt) != SQLITE_OK){
+        return results;
+    }
+    sqlite3_bind_int(stmt, 1, userId);
+    sqlite3_bind_int(stmt, 2, upToId);
+    sqlite3_bind_int(stmt, 3, limit);
+    while(step(stmt) == SQLITE_ROW){
+        secretRecord record;
+        readSecretRow(stmt, record);
+        results.push_back(std::move(record));
+    }
+    sqlite3_finalize(stmt);
+    return results;
+}
+
+bool dataBase::deleteSecret(int userId, int secretId){
+    const char* sql = "DELETE FROM secrets WHERE id = ? AND user_id = ?;";
+    sqlite3_stmt* stmt;
+    if (prepare(sql, &stmt) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, secretId);
+    sqlite3_bind_int(stmt, 2, userId);
+    bool success = (step(stmt) == SQLITE_DONE) && sqlite3_changes(m_db) == 1;
+    sqlite3_finalize(stmt);
+    return success;
+}
+
+std::vector<dataBase::secretChange> dataBase::changesSince(int userId, int64_t seq, int limit){
+    sqlite3_stmt *stmt;
+    std::vector<secretChange> results;
+    // only the newest entry of each secret; the row itself is gone for deletes
+    const char* sql =
+        "SELECT s.id, s.title, s.encrypted_data, s.iv, s.suite, s.flags, s.created_at, c.seq, c.secret_id, c.op, c.changed_at "
+        "FROM secrets_changelog c LEFT JOIN secrets s ON s.id = c.secret_id "
+        "WHERE c.user_id = ? AND c.seq > ? "
+        "AND c.seq = (SELECT max(seq) FROM secrets_changelog WHERE secret_id = c.secret_id) "
+        "ORDER BY c.seq LIMIT ?;";
+    if(prepare(sql, &stmt) != SQLITE_OK){
+        return results;
+    }
+    sqlite3_bind_int(stmt, 1, userId);
+    sqlite3_bind_int64(stmt, 2, seq);
+    sqlite3_bind_int(stmt, 3, limit);
+    while(step(stmt) == SQLITE_ROW){
+        secretChange change{};
+        change.seq = sqlite3_column_int64(stmt, 7);
+        change.secretId = sqlite3_column_int(stmt, 8);
+        change.op = static_cast<ChangeOp>(sqlite3_column_int(stmt, 9));
+        change.changedAt = sqlite3_column_int64(stmt, 10);
+        change.deleted = sqlite3_column_type(stmt, 0) == SQLITE_NULL;
+        if (!change.deleted) {
+            readSecretRow(stmt, change.record);
+        }
+        results.push_back(std::move(change));
+    }
+    sqlite3_finalize(stmt);
+    return results;
+}
+
+bool dataBase::compactChangelog(){
+    return exec("DELETE FROM secrets_changelog WHERE seq < "
+                "(SELECT max(seq) FROM secrets_changelog newer WHERE newer.secret_id = secrets_changelog.secret_id);");
+}
+
+bool dataBase::backup(const std::string &destPath, const BackupOptions &options, const BackupProgress &progress){
+    const std::string partial = destPath + ".partial";
+    bool ok;
+    if (options.passphrase.empty()) {
+        ok = copyPages(partial, options, progress);
+    } else {
+        std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+        ok = out && backup([&](const uint8_t *data, size_t size) {
+            return static_cast<bool>(out.write(reinterpret_cast<const char*>(data), size));
+        }, options, progress);
+        out.close();
+        ok = ok && out;
+    }
+    std::error_code error;
+    if (ok) {
+        std::filesystem::rename(partial, destPath, error);
+        ok = !error;
+    }
+    if (!ok) {
+        std::filesystem::remove(partial, error);
+    }
+    CRYPTIFY_LOG(LogLevel::Info, "backup to " << destPath << (ok ? " written" : " failed"));
+    return ok;
+}
+
+bool dataBase::backup(const BackupSink &sink, const BackupOptions &options, const BackupProgress &progress){
+    // staged in a private temp directory that is gone with the object, or
+    // at the next start if this process dies first
+    std::optional<BackupStaging> staging;
+    try {
+        staging.emplace();
+    } catch (const std::exception &e) {
+        CRYPTIFY_LOG(LogLevel::Error, "backup staging failed: " << e.what());
+        return false;
+    }
+    const std::string copy = staging->file("backup.db");
+    bool ok = copyPages(copy, options, progress);
+    if (ok) {
+        try {
+            ok = BackupStream::write(copy, options.passphrase, [&](const uint8_t *data, size_t size) {
+                return !options.stop.stop_requested() && sink(data, size);
+            });
+        } catch (const std::exception &e) {
+            CRYPTIFY_LOG(LogLevel::Error, "backup stream failed: " << e.what());
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool dataBase::copyPages(const std::string &destPath, const BackupOptions &options, const BackupProgress &progress){
+    std::error_code error;
+    std::filesystem::remove(destPath, error);
+    std::filesystem::remove(destPath + "-journal", error);
+    const char *vfs = m_vfs ? m_vfs->name() : nullptr;
+    sqlite3 *dest = nullptr;
+    if (sqlite3_open_v2(destPath.c_str(), &dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, vfs) != SQLITE_OK) {
+        sqlite3_close(dest);
+        return false;
+    }
+    if (m_vfs) {
+        int reserve = EncryptedVfs::kReserveBytes;
+        sqlite3_file_control(dest, "main", SQLITE_FCNTL_RESERVE_BYTES, &reserve);
+    }
+
+    // Pages are read through a connection of their own, so this one stays
+    // free for foreground calls. In WAL mode that connection holds a single
+    // read transaction for the whole copy: a fixed snapshot that writers on
+    // any connection neither block nor invalidate. In rollback-journal mode a
+    // held read lock would block every writer, so each step locks on its own
+    // and a commit elsewhere restarts the copy at page 1; after
+    // kMaxBackupRestarts of those the rest is copied in a single step.
+    constexpr int kMaxBackupRestarts = 3;
+    const char *file = sqlite3_db_filename(m_db, "main");
+    sqlite3 *source = nullptr;
+    bool snapshot = false;
+    if (file && *file) {
+        if (sqlite3_open_v2(file, &source, SQLITE_OPEN_READWRITE, vfs) != SQLITE_OK) {
+            sqlite3_close(source);
+            sqlite3_close(dest);
+            return false;
         }
-        const void* ivBlob = sqlite3_column_blob(stmt, 2);
-        int ivSize = sqlite3_column_bytes(stmt, 2);
-        if (ivBlob && ivSize > 0) {
-            const uint8_t* data = static_cast<const uint8_t*>(ivBlob);
-            record.iv.assign(data, data + ivSize);
+        sqlite3_busy_timeout(source, 1000);
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(source, "PRAGMA journal_mode;", -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW) {
+            snapshot = std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))) == "wal";
         }
-        results.push_back(record);
-        std::cout << record.title << "\n";
+        sqlite3_finalize(stmt);
+        snapshot = snapshot &&
+                   sqlite3_exec(source, "BEGIN; SELECT count(*) FROM sqlite_schema;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+    sqlite3 *from = source ? source : m_db; // in-memory databases have no file to reopen
+    sqlite3_backup *backup = sqlite3_backup_init(dest, "main", from, "main");
+    if (!backup) {
+        CRYPTIFY_LOG(LogLevel::Error, "backup init failed: " << sqlite3_errmsg(dest));
+        sqlite3_close(source);
+        sqlite3_close(dest);
+        return false;
+    }
+    // BUSY / LOCKED: a write transaction holds the source, try again next step
+    int pages = options.pagesPerStep > 0 ? options.pagesPerStep : -1;
+    int restarts = 0;
+    int lastRemaining = -1;
+    int rc;
+    bool cancelled = false;
+    for (;;) {
+        rc = sqlite3_backup_step(backup, pages);
+        if (rc != SQLITE_OK && rc != SQLITE_BUSY && rc != SQLITE_LOCKED) {
+            break;
+        }
+        const int remaining = sqlite3_backup_remaining(backup);
+        if (lastRemaining >= 0 && remaining > lastRemaining && ++restarts >= kMaxBackupRestarts && pages > 0) {
+            CRYPTIFY_LOG(LogLevel::Debug, "backup restarted " << restarts << " times, copying the rest in one step");
+            pages = -1;
+        }
+        lastRemaining = remaining;
+        if (options.stop.stop_requested() ||
+            (progress && !progress(remaining, sqlite3_backup_pagecount(backup)))) {
+            cancelled = true;
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::max(options.pauseMs, 0)));
+    }
+    if (rc == SQLITE_DONE && progress) {
+        progress(0, sqlite3_backup_pagecount(backup));
+    }
+    sqlite3_backup_finish(backup);
+    if (!cancelled && rc != SQLITE_DONE) {
+        CRYPTIFY_LOG(LogLevel::Error, "backup step failed: " << sqlite3_errstr(rc));
+    }
+    if (snapshot) {
+        sqlite3_exec(source, "COMMIT;", nullptr, nullptr, nullptr);
+    }
+    sqlite3_close(source);
+    sqlite3_close(dest);
+    return rc == SQLITE_DONE;
+}
 
+bool dataBase::startBackups(const std::string &destPath, std::chrono::seconds interval, const BackupOptions &options){
+    if (m_backups.joinable()) {
+        return false;
     }
+    m_backups = std::jthread([this, destPath, interval, options](std::stop_token stop) {
+        BackupOptions scheduled = options;
+        scheduled.stop = stop;
+        std::mutex mutex;
+        std::condition_variable_any wake;
+        while (!stop.stop_requested()) {
+            backup(destPath, scheduled);
+            std::unique_lock lock(mutex);
+            wake.wait_for(lock, stop, interval, [] { return false; });
+        }
+    });
+    return true;
+}
+
+void dataBase::stopBackups(){
+    if (m_backups.joinable()) {
+        m_backups.request_stop();
+        m_backups.join();
+    }
+}
+
+bool dataBase::beginRotation(int userId, const rotationState &state){
+    const char* sql = "INSERT INTO key_rotations (user_id, new_hash, new_salt, new_wrapped_key, new_key_iv, last_secret_id, "
+                      "rollback_wrapped_key, rollback_key_iv) VALUES (?, ?, ?, ?, ?, ?, ?, ?);";
+    sqlite3_stmt* stmt;
+    if (prepare(sql, &stmt) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, userId);
+    sqlite3_bind_blob(stmt, 2, state.newHash.data(), state.newHash.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 3, state.newSalt.data(), state.newSalt.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 4, state.newWrappedKey.data(), state.newWrappedKey.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 5, state.newKeyIv.data(), state.newKeyIv.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 6, state.lastSecretId);
+    sqlite3_bind_blob(stmt, 7, state.rollbackWrappedKey.data(), state.rollbackWrappedKey.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 8, state.rollbackKeyIv.data(), state.rollbackKeyIv.size(), SQLITE_TRANSIENT);
+    bool success = (step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
-    return results;
+    return success;
+}
 
-};
\ No newline at end of file
+bool dataBase::getRotation(int userId, rotationState &outState){
+    sqlite3_stmt *stmt;
+    const char* sql = "SELECT new_hash, new_salt, new_wrapped_key, new_key_iv, last_secret_id, rollback_wrapped_key, rollback_key_iv "
+                      "FROM key_rotations WHERE user_id = ?;";
+    if(prepare(sql, &stmt) != SQLITE_OK){
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, userId);
+    bool found = false;
+    if(step(stmt) == SQLITE_ROW){
+        const uint8_t* hash = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 0));
+        outState.newHash.assign(hash, hash + sqlite3_column_bytes(stmt, 0));
+        const uint8_t* salt = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 1));
+        outState.newSalt.assign(salt, salt + sqlite3_column_bytes(stmt, 1));
+        const uint8_t* wrapped = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 2));
+        outState.newWrappedKey.assign(wrapped, wrapped + sqlite3_column_bytes(stmt, 2));
+        const uint8_t* keyIv = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 3));
+        outState.newKeyIv.assign(keyIv, keyIv + sqlite3_column_bytes(stmt, 3));
+        outState.lastSecretId = sqlite3_column_int(stmt, 4);
+        const uint8_t* rollbackKey = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 5));
+        outState.rollbackWrappedKey.assign(rollbackKey, rollbackKey + sqlite3_column_bytes(stmt, 5));
+        const uint8_t* rollbackIv = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 6));
+        outState.rollbackKeyIv.assign(rollbackIv, rollbackIv + sqlite3_column_bytes(stmt, 6));
+        found = true;
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// writes one re-encrypted batch and advances the rotation cursor in the same
+// transaction, so a crash leaves every row either fully old or fully new
+bool dataBase::commitRotationBatch(int userId, const std::vector<secretRecord> &records, int lastSecretId){
+    if (!exec("BEGIN IMMEDIATE;")) {
+        return false;
+    }
+    sqlite3_stmt* update;
+    const char* sql = "UPDATE secrets SET encrypted_data = ?, iv = ?, suite = ? WHERE id = ? AND user_id = ?;";
+    if (prepare(sql, &update) != SQLITE_OK) {
+        exec("ROLLBACK;");
+        return false;
+    }
+    bool success = true;
+    for (const auto& record : records) {
+        sqlite3_bind_blob(update, 1, record.encryptedData.data(), record.encryptedData.size(), SQLITE_TRANSIENT);
+        sqlite3_bind_blob(update, 2, record.iv.data(), record.iv.size(), SQLITE_TRANSIENT);
+        sqlite3_bind_int(update, 3, static_cast<int>(record.suite));
+        sqlite3_bind_int(update, 4, record.id);
+        sqlite3_bind_int(update, 5, userId);
+        if (step(update) != SQLITE_DONE) {
+            success = false;
+            break;
+        }
+        sqlite3_reset(update);
+    }
+    sqlite3_finalize(update);
+
+    sqlite3_stmt* cursor;
+    const char* cursorSql = "UPDATE key_rotations SET last_secret_id = ? WHERE user_id = ?;";
+    if (success && prepare(cursorSql, &cursor) == SQLITE_OK) {
+        sqlite3_bind_int(cursor, 1, lastSecretId);
+        sqlite3_bind_int(cursor, 2, userId);
+        success = (step(cursor) == SQLITE_DONE);
+        sqlite3_finalize(cursor);
+    } else {
+        success = false;
+    }
+
+    if (!success) {
+        exec("ROLLBACK;");
+        return false;
+    }
+    return commit();
+}
+
+// swaps in the new credentials and drops the rotation row atomically
+bool dataBase::finishRotation(int userId){
+    if (!exec("BEGIN IMMEDIATE;")) {
+        return false;
+    }
+    sqlite3_stmt* stmt;
+    const char* sql =
+        "UPDATE users SET password_hash = (SELECT new_hash FROM key_rotations WHERE user_id = ?1), "
+        "salt = (SELECT new_salt FROM key_rotations WHERE user_id = ?1), "
+        "wrapped_key = (SELECT new_wrapped_key FROM key_rotations WHERE user_id = ?1), "
+        "key_iv = (SELECT new_key_iv FROM key_rotations WHERE user_id = ?1) "
+        "WHERE id = ?1 AND EXISTS (SELECT 1 FROM key_rotations WHERE user_id = ?1);";
+    if (prepare(sql, &stmt) != SQLITE_OK) {
+        exec("ROLLBACK;");
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, userId);
+    bool success = (step(stmt) == SQLITE_DONE) && sqlite3_changes(m_db) == 1;
+    sqlite3_finalize(stmt);
+
+    if (success && prepare("DELETE FROM key_rotations WHERE user_id = ?;", &stmt) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, userId);
+        success = (step(stmt) == SQLITE_DONE);
+        sqlite3_finalize(stmt);
+    } else {
+        success = false;
+    }
+
+    if (!success) {
+        exec("ROLLBACK;");
+        return false;
+    }
+    return commit();
+}
+
+bool dataBase::cancelRotation(int userId){
+    sqlite3_stmt* stmt;
+    if (prepare("DELETE FROM key_rotations WHERE user_id = ?;", &stmt) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, userId);
+    bool success = (step(stmt) == SQLITE_DONE) && sqlite3_changes(m_db) == 1;
+    sqlite3_finalize(stmt);
+    return success;
+}
+
+int dataBase::prepare(const char *sql, sqlite3_stmt **stmt){
+    ScopedTimer timer(MetricOp::Prepare);
+    return sqlite3_prepare_v2(m_db, sql, -1, stmt, nullptr);
+}
+
+int dataBase::step(sqlite3_stmt *stmt){
+    ScopedTimer timer(MetricOp::Step);
+    return sqlite3_step(stmt);
+}
+
+bool dataBase::commit(){
+    ScopedTimer timer(MetricOp::Commit);
+    return exec("COMMIT;");
+}
+
+bool dataBase::exec(const char *sql){
+    char* error_msg = nullptr;
+    if (sqlite3_exec(m_db, sql, nullptr, nullptr, &error_msg) != SQLITE_OK) {
+        sqlite3_free(error_msg);
+        return false;
+    }
+    return true;
+}
+
+bool dataBase::ensureColumn(const char *table, const char *column, const char *type){
+    sqlite3_stmt* stmt;
+    std::string info = std::string("PRAGMA table_info(") + table + ");";
+    if (prepare(info.c_str(), &stmt) != SQLITE_OK) {
+        return false;
+    }
+    bool present = false;
+    while (step(stmt) == SQLITE_ROW) {
+        if (std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))) == column) {
+            present = true;
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (present) {
+        return true;
+    }
+    std::string alter = std::string("ALTER TABLE ") + table + " ADD COLUMN " + column + " " + type + ";";
+    return exec(alter.c_str());
+}
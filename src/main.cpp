@@ -4,6 +4,13 @@
 #include "CryptoManager.hpp"
 #include <limits> // tinkering with this later .....
 #include "CLI.hpp"
+#include "KeyRotation.hpp"
+#include "KdfExecutor.hpp"
+#include "BreachCorpus.hpp"
+#include "VaultAudit.hpp"
+#include <charconv>
+#include <cstring>
+#include <memory>
 
 
 
@@ -12,7 +19,147 @@
 
 
 
-int main() {
+// the op column is read back from the database, so unknown values are possible
+static const char *opName(dataBase::ChangeOp op) {
+    switch (op) {
+    case dataBase::ChangeOp::Insert: return "insert";
+    case dataBase::ChangeOp::Update: return "update";
+    case dataBase::ChangeOp::Delete: return "delete";
+    }
+    return "unknown";
+}
+
+// cryptify sync <username> [since-seq]: prints every secret changed after
+// since-seq (titles only, nothing is decrypted) and the cursor to pass next time
+static int runSync(dataBase &db, int argc, char *argv[]) {
+    int64_t cursor = 0;
+    bool validCursor = true;
+    if (argc > 3) {
+        const char *end = argv[3] + std::strlen(argv[3]);
+        auto [rest, error] = std::from_chars(argv[3], end, cursor);
+        validCursor = error == std::errc() && rest == end && cursor >= 0;
+    }
+    if (argc < 3 || !validCursor) {
+        std::cerr << "usage: " << argv[0] << " sync <username> [since-seq]\n";
+        return 2;
+    }
+    dataBase::UserQuerey user;
+    std::string password = CLI::getPassword("password :");
+    if (!db.getUser(argv[2], user) || CryptoManager::hashPassword(password, user.salt) != user.hash) {
+        std::cerr << "login failed\n";
+        return 1;
+    }
+    for (;;) {
+        auto changes = db.changesSince(user.id, cursor);
+        if (changes.empty()) break;
+        for (const auto &change : changes) {
+            std::cout << change.seq << ' ' << opName(change.op) << ' ' << change.secretId;
+            if (!change.deleted) std::cout << ' ' << change.record.title;
+            std::cout << '\n';
+            cursor = change.seq;
+        }
+    }
+    std::cout << "cursor " << cursor << '\n';
+    return 0;
+}
+
+// cryptify audit <username> [breach-corpus]: lists reused, weak, old and
+// breached passwords, then a summary
+static int runAudit(dataBase &db, int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " audit <username> [breach-corpus]\n";
+        return 2;
+    }
+    dataBase::UserQuerey user;
+    std::string password = CLI::getPassword("password :");
+    if (!db.getUser(argv[2], user) || CryptoManager::hashPassword(password, user.salt) != user.hash) {
+        std::cerr << "login failed\n";
+        return 1;
+    }
+    auto vaultKey = KdfExecutor::shared().submit([&] {
+        return CryptoManager::openVaultKey(password, user.salt, user.wrappedKey, user.keyIv);
+    }).get();
+    AuditOptions options;
+    std::unique_ptr<BreachCorpus> breaches;
+    if (argc > 3) {
+        breaches = std::make_unique<BreachCorpus>(argv[3]);
+        options.breaches = breaches.get();
+    }
+    auto summary = VaultAudit::run(db, user.id, vaultKey, [](const AuditFinding &finding) {
+        if (!finding.flags) return;
+        std::cout << finding.title << ':';
+        if (finding.flags & AuditUnreadable) std::cout << " unreadable";
+        if (finding.flags & AuditReused) std::cout << " reused(" << finding.reuseCount << ')';
+        if (finding.flags & AuditWeak) std::cout << " weak(" << finding.score << "/4)";
+        if (finding.flags & AuditBreached) std::cout << " breached(" << finding.breachCount << ')';
+        if (finding.flags & AuditOld) std::cout << " old(" << finding.ageDays << " days)";
+        std::cout << '\n';
+    }, options);
+    std::cout << summary.records << " records: " << summary.reused << " reused, " << summary.weak << " weak, "
+              << summary.breached << " breached, " << summary.old << " old, " << summary.unreadable << " unreadable\n";
+    return 0;
+}
+
+// cryptify backup <destination> [--encrypt]: online copy of cryptify.db that
+// other processes can keep writing to; --encrypt seals it under a passphrase
+static int runBackup(dataBase &db, int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " backup <destination> [--encrypt]\n";
+        return 2;
+    }
+    BackupOptions options;
+    if (argc > 3 && std::string(argv[3]) == "--encrypt") {
+        options.passphrase = CLI::getPassword("backup passphrase :");
+    }
+    bool ok = db.backup(argv[2], options, [](int remaining, int total) {
+        std::cerr << '\r' << (total - remaining) << '/' << total << " pages" << std::flush;
+        return true;
+    });
+    std::cerr << '\n';
+    if (!ok) {
+        std::cerr << "backup failed\n";
+        return 1;
+    }
+    return 0;
+}
+
+// cryptify restore <sealed-backup> <destination>: undoes backup --encrypt
+static int runRestore(int argc, char *argv[]) {
+    if (argc < 4) {
+        std::cerr << "usage: " << argv[0] << " restore <sealed-backup> <destination>\n";
+        return 2;
+    }
+    try {
+        BackupStream::unseal(argv[2], CLI::getPassword("backup passphrase :"), argv[3]);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // subcommands report failures instead of terminating
+    try {
+        if (argc > 1 && std::string(argv[1]) == "sync") {
+            dataBase db{"cryptify.db"};
+            return runSync(db, argc, argv);
+        }
+        if (argc > 1 && std::string(argv[1]) == "audit") {
+            dataBase db{"cryptify.db"};
+            return runAudit(db, argc, argv);
+        }
+        if (argc > 1 && std::string(argv[1]) == "backup") {
+            dataBase db{"cryptify.db"};
+            return runBackup(db, argc, argv);
+        }
+        if (argc > 1 && std::string(argv[1]) == "restore") {
+            return runRestore(argc, argv);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
     auto title = "starting Cryptify...";
     CLI::printBanner(title);
     dataBase db{"cryptify.db"}; 
@@ -22,8 +169,10 @@ int main() {
 
     auto salt = CryptoManager::generateRandomBytes(16);
     auto passHash = CryptoManager::hashPassword(password, salt);
+    std::vector<uint8_t> wrappedKey, keyIv;
+    KeyRotation::createVaultKey(password, salt, wrappedKey, keyIv);
 
-    if(db.addUser(username, passHash, salt)){
+    if(db.addUser(username, passHash, salt, wrappedKey, keyIv)){
         std::cout << "user created successfully \n";
     }else {
         std::cout << "user creation failed  \n";
@@ -39,7 +188,9 @@ int main() {
     std::vector<uint8_t> currentMasterKey;
     if (passHash == outData.hash){
         std::cout << "login successfull welcome back  \n";
-        currentMasterKey = CryptoManager::deriveKey(password, salt);
+        currentMasterKey = KdfExecutor::shared().submit([&] {
+            return CryptoManager::openVaultKey(password, outData.salt, outData.wrappedKey, outData.keyIv);
+        }).get();
 
     }else {
         std::cout << "user login failed  \n";
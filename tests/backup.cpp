@@ -0,0 +1,196 @@
+// Online backup while another connection keeps writing, in both journal
+// modes, plus sealed streaming, cancellation and stale staging cleanup.
+#include "CryptoManager.hpp"
+#include "dBase.hpp"
+#include <sqlite3.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string &what)
+{
+    std::printf("%s: %s\n", ok ? "ok  " : "FAIL", what.c_str());
+    if (!ok) ++failures;
+}
+
+std::string tempPath(const std::string &name)
+{
+    return (std::filesystem::temp_directory_path() / ("cryptify_backup_" + std::to_string(getpid()) + "_" + name)).string();
+}
+
+void removeAll(const std::string &path)
+{
+    for (const char *suffix : {"", "-journal", "-wal", "-shm", ".partial"}) std::filesystem::remove(path + suffix);
+}
+
+std::string query(const std::string &path, const char *sql)
+{
+    sqlite3 *db = nullptr;
+    sqlite3_stmt *stmt = nullptr;
+    std::string out = "<error>";
+    if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK &&
+        sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        out = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return out;
+}
+
+// ~8 MB of secrets, the journal mode set before any other connection opens it
+int prepare(const std::string &path, bool wal)
+{
+    removeAll(path);
+    {
+        sqlite3 *raw = nullptr;
+        sqlite3_open(path.c_str(), &raw);
+        sqlite3_exec(raw, wal ? "PRAGMA journal_mode = WAL;" : "PRAGMA journal_mode = DELETE;", nullptr, nullptr, nullptr);
+        sqlite3_close(raw);
+    }
+    dataBase db(path);
+    auto salt = CryptoManager::generateRandomBytes(16);
+    db.addUser("u", CryptoManager::hashPassword("p", salt), salt);
+    dataBase::UserQuerey user;
+    db.getUser("u", user);
+    std::vector<uint8_t> blob(2000, 7), iv(12, 1);
+    sqlite3 *raw = nullptr;
+    sqlite3_open(path.c_str(), &raw);
+    sqlite3_exec(raw, "BEGIN;", nullptr, nullptr, nullptr);
+    sqlite3_stmt *stmt = nullptr;
+    sqlite3_prepare_v2(raw, "INSERT INTO secrets (user_id, title, encrypted_data, iv) VALUES (?, ?, ?, ?);", -1, &stmt, nullptr);
+    for (int i = 0; i < 4000; ++i) {
+        std::string title = "seed-" + std::to_string(i);
+        sqlite3_bind_int(stmt, 1, user.id);
+        sqlite3_bind_text(stmt, 2, title.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_blob(stmt, 3, blob.data(), static_cast<int>(blob.size()), SQLITE_STATIC);
+        sqlite3_bind_blob(stmt, 4, iv.data(), static_cast<int>(iv.size()), SQLITE_STATIC);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(raw, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_close(raw);
+    return user.id;
+}
+
+// backup of a database another connection commits to every 5 ms
+void concurrentWriter(bool wal)
+{
+    const std::string mode = wal ? "wal" : "rollback";
+    const std::string path = tempPath(mode + ".db"), dest = tempPath(mode + "_copy.db");
+    const int userId = prepare(path, wal);
+    removeAll(dest);
+
+    dataBase owner(path);
+    owner.setBusyTimeout(5000);
+    std::atomic<bool> stop{false};
+    std::atomic<int> writes{0};
+    std::thread writer([&] {
+        dataBase other(path);
+        other.setBusyTimeout(5000);
+        std::vector<uint8_t> blob(2000, 9), iv(12, 2);
+        for (int i = 0; !stop; ++i) {
+            if (other.addSecret(userId, "live-" + std::to_string(i), blob, iv)) ++writes;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+
+    int steps = 0;
+    int lastRemaining = -1;
+    bool monotonic = true;
+    auto started = std::chrono::steady_clock::now();
+    bool ok = owner.backup(dest, BackupOptions{}, [&](int remaining, int) {
+        if (lastRemaining >= 0 && remaining > lastRemaining) monotonic = false;
+        lastRemaining = remaining;
+        return ++steps < 10000;
+    });
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    stop = true;
+    writer.join();
+
+    check(ok, mode + ": backup completed in " + std::to_string(steps) + " steps, " + std::to_string(seconds) + " s");
+    check(writes > 0, mode + ": writer committed " + std::to_string(writes.load()) + " rows meanwhile");
+    check(seconds < 20, mode + ": finished in bounded time");
+    check(query(dest, "PRAGMA integrity_check;") == "ok", mode + ": copy passes integrity_check");
+    if (wal) check(monotonic, "wal: snapshot copy never restarted");
+    removeAll(path);
+    removeAll(dest);
+}
+
+int stagingDirectories()
+{
+    int count = 0;
+    const std::string prefix = "cryptify-backup-" + std::to_string(getpid()) + "-";
+    for (const auto &entry : std::filesystem::directory_iterator(std::filesystem::temp_directory_path())) {
+        if (entry.path().filename().string().rfind(prefix, 0) == 0) ++count;
+    }
+    return count;
+}
+
+void sealedStream()
+{
+    const std::string path = tempPath("sealed_src.db"), sealed = tempPath("sealed.bin"), restored = tempPath("restored.db");
+    prepare(path, false);
+    dataBase db(path);
+    BackupOptions options;
+    options.passphrase = "backup-pass";
+    {
+        std::ofstream out(sealed, std::ios::binary);
+        bool sawStaging = false;
+        bool ok = db.backup([&](const uint8_t *data, size_t size) {
+            sawStaging = sawStaging || stagingDirectories() == 1;
+            return static_cast<bool>(out.write(reinterpret_cast<const char *>(data), size));
+        }, options);
+        check(ok && sawStaging, "sealed: streamed from a private staging directory");
+    }
+    check(stagingDirectories() == 0, "sealed: staging directory removed");
+    BackupStream::unseal(sealed, "backup-pass", restored);
+    check(query(restored, "SELECT count(*) FROM secrets;") == "4000", "sealed: restored all rows");
+
+    // cancelled in the streaming phase, after the pages were copied
+    std::stop_source source;
+    options.stop = source.get_token();
+    size_t chunks = 0;
+    bool ok = db.backup([&](const uint8_t *, size_t) {
+        source.request_stop();
+        return ++chunks < 1000;
+    }, options);
+    check(!ok && chunks == 1, "sealed: stop token cancels the stream");
+    check(stagingDirectories() == 0, "sealed: staging directory removed after cancel");
+    removeAll(path);
+    removeAll(sealed);
+    removeAll(restored);
+}
+
+void staleStaging()
+{
+    pid_t child = fork();
+    if (child == 0) _exit(0);
+    waitpid(child, nullptr, 0);
+    auto stale = std::filesystem::temp_directory_path() / ("cryptify-backup-" + std::to_string(child) + "-test");
+    std::filesystem::create_directory(stale);
+    std::ofstream(stale / "backup.db") << "left behind";
+    BackupStaging::removeStale();
+    check(!std::filesystem::exists(stale), "staging of a dead process removed");
+}
+
+} // namespace
+
+int main()
+{
+    concurrentWriter(false);
+    concurrentWriter(true);
+    sealedStream();
+    staleStaging();
+    return failures == 0 ? 0 : 1;
+}
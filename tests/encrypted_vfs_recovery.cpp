@@ -0,0 +1,137 @@
+// Crash recovery through EncryptedVfs: a child process dies in the middle of
+// a write and a fresh VFS instance (as in a new process) must replay the
+// hot rollback journal or the WAL exactly like a plaintext database would.
+#include "CryptoManager.hpp"
+#include "EncryptedVfs.hpp"
+#include <sqlite3.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace {
+
+const char *const kPassphrase = "recovery-test";
+constexpr int kRows = 200;
+
+struct Connection
+{
+    std::unique_ptr<EncryptedVfs> vfs; // outlives db
+    sqlite3 *db = nullptr;
+
+    explicit Connection(const std::string &path)
+    {
+        auto salt = EncryptedVfs::readSalt(path);
+        if (salt.empty()) salt = CryptoManager::generateRandomBytes(EncryptedVfs::kSaltBytes);
+        vfs = std::make_unique<EncryptedVfs>(CryptoManager::deriveKey(kPassphrase, salt), salt);
+        sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, vfs->name());
+        int reserve = EncryptedVfs::kReserveBytes;
+        sqlite3_file_control(db, "main", SQLITE_FCNTL_RESERVE_BYTES, &reserve);
+        exec("PRAGMA temp_store = MEMORY;");
+    }
+    ~Connection() { sqlite3_close(db); }
+
+    bool exec(const std::string &sql) { return sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK; }
+    std::string text(const std::string &sql)
+    {
+        sqlite3_stmt *stmt = nullptr;
+        std::string out = "<error>";
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char *value = sqlite3_column_text(stmt, 0);
+            out = value ? reinterpret_cast<const char *>(value) : "";
+        }
+        sqlite3_finalize(stmt);
+        return out;
+    }
+};
+
+void removeAll(const std::string &path)
+{
+    for (const char *suffix : {"", "-journal", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+}
+
+// runs body in a child; body ends with _exit, so nothing is closed or cleaned up
+bool crashAfter(void (*body)(const std::string &), const std::string &path)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        body(path);
+        _exit(1);
+    }
+    int status = 0;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void fill(Connection &c)
+{
+    c.exec("CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT);");
+    c.exec("BEGIN;");
+    for (int i = 0; i < kRows; ++i) {
+        c.exec("INSERT INTO t (v) VALUES ('before-" + std::to_string(i) + "' || hex(randomblob(300)));");
+    }
+    c.exec("COMMIT;");
+}
+
+// rollback journal: a tiny cache spills dirty pages into the db file before
+// the transaction commits, so recovery has to play the journal back
+void journalCrash(const std::string &path)
+{
+    Connection c(path);
+    fill(c);
+    c.exec("PRAGMA cache_size = 2;");
+    c.exec("BEGIN;");
+    c.exec("UPDATE t SET v = 'after' || hex(randomblob(400));");
+    _exit(0);
+}
+
+// WAL: the committed update lives only in the WAL when the process dies
+void walCrash(const std::string &path)
+{
+    Connection c(path);
+    c.exec("PRAGMA journal_mode = WAL;");
+    c.exec("PRAGMA wal_autocheckpoint = 0;");
+    fill(c);
+    c.exec("PRAGMA wal_checkpoint(TRUNCATE);");
+    c.exec("UPDATE t SET v = 'committed' WHERE id = 1;");
+    _exit(0);
+}
+
+int failures = 0;
+
+void check(bool ok, const char *what)
+{
+    std::printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) ++failures;
+}
+
+} // namespace
+
+int main()
+{
+    const std::string path = (std::filesystem::temp_directory_path() /
+                              ("cryptify_recovery_" + std::to_string(getpid()) + ".db")).string();
+
+    removeAll(path);
+    check(crashAfter(journalCrash, path), "journal: child ran");
+    check(std::filesystem::exists(path + "-journal"), "journal: hot journal left behind");
+    {
+        Connection c(path);
+        check(c.text("PRAGMA integrity_check;") == "ok", "journal: integrity_check");
+        check(c.text("SELECT count(*) FROM t WHERE v LIKE 'before-%';") == std::to_string(kRows),
+              "journal: uncommitted update rolled back");
+    }
+
+    removeAll(path);
+    check(crashAfter(walCrash, path), "wal: child ran");
+    check(std::filesystem::exists(path + "-wal"), "wal: wal left behind");
+    {
+        Connection c(path);
+        check(c.text("PRAGMA integrity_check;") == "ok", "wal: integrity_check");
+        check(c.text("SELECT v FROM t WHERE id = 1;") == "committed", "wal: committed update kept");
+        check(c.text("SELECT count(*) FROM t;") == std::to_string(kRows), "wal: row count");
+    }
+    removeAll(path);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+// A key rotation that stops half way: records it already moved are refused
+// instead of failing to decrypt, a different new password is refused, and
+// abortRotation with only the current password restores the whole vault.
+#include "CryptoManager.hpp"
+#include "KeyRotation.hpp"
+#include "cryptify.h"
+#include <unistd.h>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string &what)
+{
+    std::printf("%s: %s\n", ok ? "ok  " : "FAIL", what.c_str());
+    if (!ok) ++failures;
+}
+
+std::string tempPath(const std::string &name)
+{
+    return (std::filesystem::temp_directory_path() / ("cryptify_rotation_" + std::to_string(getpid()) + "_" + name)).string();
+}
+
+constexpr int kSecrets = 40;
+constexpr int kBroken = 25; // the rotation stops at this record
+
+} // namespace
+
+int main()
+{
+    const std::string path = tempPath("vault.db");
+    std::filesystem::remove(path);
+    {
+        dataBase db(path);
+        auto salt = CryptoManager::generateRandomBytes(16);
+        std::vector<uint8_t> wrappedKey, keyIv;
+        KeyRotation::createVaultKey("old", salt, wrappedKey, keyIv);
+        db.addUser("alice", CryptoManager::hashPassword("old", salt), salt, wrappedKey, keyIv);
+        dataBase::UserQuerey user;
+        db.getUser("alice", user);
+        auto key = CryptoManager::openVaultKey("old", user.salt, user.wrappedKey, user.keyIv);
+        for (int i = 1; i <= kSecrets; ++i) {
+            auto iv = CryptoManager::generateRandomBytes(12);
+            auto data = CryptoManager::encrypt(CipherSuite::Aes256Gcm, "secret-" + std::to_string(i), key, iv);
+            // a record that cannot be decrypted makes the rotation throw
+            // after committing the batches before it, like a crash would
+            if (i == kBroken) data[0] ^= 1;
+            db.addSecret(user.id, "site-" + std::to_string(i), data, iv);
+        }
+
+        bool threw = false;
+        try {
+            KeyRotation::rotateVaultKey(db, "alice", "old", RotationOptions{1, 1});
+        } catch (const std::exception &) {
+            threw = true;
+        }
+        dataBase::rotationState state;
+        check(threw && db.getRotation(user.id, state) && state.lastSecretId == kBroken - 1,
+              "rotation stopped before the broken record");
+    }
+
+    cryptify_vault *vault = nullptr;
+    check(cryptify_open(path.c_str(), &vault) == CRYPTIFY_OK, "open");
+    check(cryptify_login(vault, "alice", "old") == CRYPTIFY_OK, "login with the current password");
+    uint8_t *data = nullptr;
+    size_t length = 0;
+    check(cryptify_get_secret(vault, "site-3", &data, &length) == CRYPTIFY_ERR_ROTATING,
+          "moved record is refused with CRYPTIFY_ERR_ROTATING");
+    check(cryptify_get_secret(vault, "site-30", &data, &length) == CRYPTIFY_OK &&
+              std::string(reinterpret_cast<char *>(data), length) == "secret-30",
+          "record past the cursor still reads");
+    cryptify_free(data);
+    check(cryptify_change_password(vault, "alice", "old", "other") == CRYPTIFY_ERR_ROTATING,
+          "a different new password is refused");
+    check(cryptify_snapshot_export(vault, "alice", tempPath("vault.snap").c_str()) == CRYPTIFY_ERR_ROTATING,
+          "snapshot export is refused");
+
+    check(cryptify_abort_rotation(vault, "alice", "wrong") == CRYPTIFY_ERR_AUTH, "abort needs the current password");
+    check(cryptify_abort_rotation(vault, "alice", "old") == CRYPTIFY_OK, "abort without the new password");
+    check(cryptify_abort_rotation(vault, "alice", "old") == CRYPTIFY_ERR_NOT_FOUND, "nothing left to abort");
+
+    int readable = 0;
+    for (int i = 1; i <= kSecrets; ++i) {
+        const std::string title = "site-" + std::to_string(i);
+        if (cryptify_get_secret(vault, title.c_str(), &data, &length) == CRYPTIFY_OK &&
+            std::string(reinterpret_cast<char *>(data), length) == "secret-" + std::to_string(i)) {
+            ++readable;
+        }
+        cryptify_free(data);
+        data = nullptr;
+    }
+    check(readable == kSecrets - 1, "every record reads under the current password again");
+    check(cryptify_login(vault, "alice", "old") == CRYPTIFY_OK, "credentials unchanged");
+    cryptify_close(vault);
+
+    std::filesystem::remove(path);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+// Every PBKDF2 kernel this CPU supports must match OpenSSL bit for bit, and
+// best() must only pick a kernel once that holds.
+#include "MultiPbkdf2.hpp"
+#include <cstdio>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string &what)
+{
+    std::printf("%s: %s\n", ok ? "ok  " : "FAIL", what.c_str());
+    if (!ok) ++failures;
+}
+
+} // namespace
+
+int main()
+{
+    using Kernel = MultiPbkdf2::Kernel;
+    for (Kernel kernel : {Kernel::OpenSsl, Kernel::Portable, Kernel::ShaNi, Kernel::Avx2, Kernel::Avx512}) {
+        std::printf("      %s %s\n", MultiPbkdf2::name(kernel),
+                    MultiPbkdf2::available(kernel) ? "available" : "not available");
+    }
+    const bool matches = MultiPbkdf2::selfTest();
+    check(matches, "kernels match OpenSSL");
+    const Kernel best = MultiPbkdf2::best();
+    check(MultiPbkdf2::available(best), std::string("best() is available: ") + MultiPbkdf2::name(best));
+    check(matches || best == Kernel::OpenSsl, "best() falls back to OpenSSL on a mismatch");
+    return failures == 0 ? 0 : 1;
+}
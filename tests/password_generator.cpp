@@ -0,0 +1,180 @@
+// Password and passphrase generation: lengths, required classes, allowed
+// characters, policy and wordlist validation, and the sampling helpers.
+#include "PasswordGenerator.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string &what)
+{
+    std::printf("%s: %s\n", ok ? "ok  " : "FAIL", what.c_str());
+    if (!ok) ++failures;
+}
+
+template <typename F>
+bool throws(F &&body)
+{
+    try {
+        body();
+    } catch (const std::runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+bool containsAny(const std::string &text, const std::string &chars)
+{
+    return text.find_first_of(chars) != std::string::npos;
+}
+
+std::vector<std::string> split(const std::string &text, const std::string &separator)
+{
+    std::vector<std::string> parts;
+    size_t start = 0;
+    for (size_t at; (at = text.find(separator, start)) != std::string::npos; start = at + separator.size()) {
+        parts.push_back(text.substr(start, at - start));
+    }
+    parts.push_back(text.substr(start));
+    return parts;
+}
+
+const std::string kLower = "abcdefghijklmnopqrstuvwxyz";
+const std::string kUpper = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+const std::string kDigits = "0123456789";
+
+} // namespace
+
+int main()
+{
+    // 1. RandomStream
+    {
+        RandomStream random(16); // small buffer, so refills are exercised
+        std::vector<int> counts(3);
+        bool inRange = true;
+        for (int i = 0; i < 30000; ++i) {
+            uint32_t value = random.uniform(3);
+            inRange = inRange && value < 3;
+            if (value < 3) counts[value]++;
+        }
+        check(inRange, "uniform(3) stays below its bound");
+        check(std::all_of(counts.begin(), counts.end(), [](int n) { return n > 9000 && n < 11000; }),
+              "uniform(3) is roughly even");
+        check(random.uniform(1) == 0, "uniform(1) is 0");
+    }
+
+    // 2. passwords
+    for (size_t length : {size_t{4}, size_t{20}, size_t{64}}) {
+        PasswordPolicy policy;
+        policy.length = length;
+        PasswordGenerator generator(policy);
+        auto passwords = generator.generate(200);
+        check(passwords.size() == 200, "generate(count) returns count passwords");
+        bool lengths = true, classes = true;
+        for (const auto &password : passwords) {
+            lengths = lengths && password.size() == length;
+            // length 4 with four classes only passes by regenerating
+            classes = classes && containsAny(password, kLower) && containsAny(password, kUpper) &&
+                      containsAny(password, kDigits) && containsAny(password, policy.symbolSet);
+        }
+        check(lengths, "every password has length " + std::to_string(length));
+        check(classes, "every required class appears at length " + std::to_string(length));
+    }
+    {
+        PasswordPolicy policy;
+        policy.upper = false;
+        policy.symbolSet = "#!";
+        policy.excludeAmbiguous = true;
+        PasswordGenerator generator(policy);
+        const std::string allowed = "abcdefghijkmnpqrstuvwxyz23456789#!";
+        bool onlyAllowed = true;
+        for (const auto &password : generator.generate(200)) {
+            onlyAllowed = onlyAllowed && password.find_first_not_of(allowed) == std::string::npos;
+        }
+        check(onlyAllowed, "only enabled, unambiguous characters are used");
+    }
+    {
+        PasswordPolicy oneChar;
+        oneChar.lower = oneChar.upper = oneChar.digits = false;
+        oneChar.symbolSet = "xx";
+        check(throws([&] { PasswordGenerator{oneChar}; }), "a one-character charset is rejected");
+        PasswordPolicy none;
+        none.lower = none.upper = none.digits = none.symbols = false;
+        check(throws([&] { PasswordGenerator{none}; }), "an empty charset is rejected");
+        PasswordPolicy zero;
+        zero.length = 0;
+        check(throws([&] { PasswordGenerator{zero}; }), "length 0 is rejected");
+        PasswordPolicy tooShort;
+        tooShort.length = 3;
+        check(throws([&] { PasswordGenerator{tooShort}; }), "length below the required class count is rejected");
+        tooShort.requireEachClass = false;
+        check(!throws([&] { PasswordGenerator{tooShort}; }), "the same length is fine without requireEachClass");
+    }
+
+    // 3. passphrases
+    const std::vector<std::string> words = {"apple", "brick", "cedar", "delta", "ember"};
+    {
+        PassphrasePolicy policy;
+        policy.words = 5;
+        policy.separator = "::";
+        PassphraseGenerator generator(words, policy);
+        bool shape = true;
+        for (const auto &phrase : generator.generate(100)) {
+            auto parts = split(phrase, "::");
+            shape = shape && parts.size() == 5 && std::all_of(parts.begin(), parts.end(), [&](const std::string &part) {
+                return std::find(words.begin(), words.end(), part) != words.end();
+            });
+        }
+        check(shape, "passphrases are the requested number of listed words");
+    }
+    {
+        PassphrasePolicy policy;
+        policy.words = 4;
+        policy.capitalize = true;
+        policy.appendDigit = true;
+        PassphraseGenerator generator(words, policy);
+        bool shape = true;
+        for (const auto &phrase : generator.generate(100)) {
+            auto parts = split(phrase, policy.separator);
+            int digits = 0;
+            for (const auto &part : parts) {
+                shape = shape && !part.empty() && part[0] >= 'A' && part[0] <= 'Z';
+                digits += static_cast<int>(std::count_if(part.begin(), part.end(), [](char c) { return c >= '0' && c <= '9'; }));
+            }
+            shape = shape && parts.size() == 4 && digits == 1;
+        }
+        check(shape, "capitalize and appendDigit shape every passphrase");
+    }
+    check(throws([] { PassphraseGenerator({}); }), "an empty wordlist is rejected");
+    check(throws([] { PassphraseGenerator({"same", "same", ""}); }), "a wordlist of one distinct word is rejected");
+    {
+        PassphrasePolicy none;
+        none.words = 0;
+        check(throws([&] { PassphraseGenerator(words, none); }), "zero words are rejected");
+    }
+
+    // 4. wordlist files
+    {
+        RandomStream random;
+        const auto path = std::filesystem::temp_directory_path() /
+                          ("cryptify_wordlist_" + std::to_string(random.nextWord()) + ".txt");
+        {
+            std::ofstream out(path);
+            out << "11111\tabacus\n11112\tabdomen  \n\n11113\tabacus\nplain\n";
+        }
+        auto loaded = PassphraseGenerator::loadWordlist(path.string());
+        check(loaded == std::vector<std::string>({"abacus", "abdomen", "plain"}),
+              "diceware and plain lines load without duplicates or blanks");
+        std::filesystem::remove(path);
+        check(throws([&] { PassphraseGenerator::loadWordlist(path.string()); }), "a missing wordlist throws");
+    }
+
+    return failures == 0 ? 0 : 1;
+}